@@ -0,0 +1,151 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* FastBorder, used for window frames and drag rectangles. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+/* Raster operations handled here. */
+#define ROP_PATCOPY     0xF0
+#define ROP_PATINVERT   0x5A
+#define ROP_DSTINVERT   0x55
+
+static LPDIBENGINE  lpBorderDev;
+static WORD         wBorderRop;
+static LPRECT       lpBorderClip;
+
+/* Fill one edge of the border, clipped. The right and bottom edges of
+ * the rectangle are exclusive.
+ */
+static void BorderEdge( int left, int top, int right, int bottom )
+{
+    LPRECT  lpClip = lpBorderClip;
+
+    if( lpClip ) {
+        if( left < lpClip->left )
+            left = lpClip->left;
+        if( top < lpClip->top )
+            top = lpClip->top;
+        if( right > lpClip->right )
+            right = lpClip->right;
+        if( bottom > lpClip->bottom )
+            bottom = lpClip->bottom;
+    }
+    if( left >= right || top >= bottom )
+        return;
+
+    if( wBorderRop == ROP_DSTINVERT ) {
+        KernJob.wDstSel   = lpBorderDev->deBitsSelector;
+        KernJob.lDstPitch = lpBorderDev->deDeltaScan;
+        KernJob.dwDstOfs  = lpBorderDev->deBitsOffset + (long)top * lpBorderDev->deDeltaScan
+                          + (DWORD)left * (lpBorderDev->deBitsPixel >> 3);
+        KernJob.wWidth    = right - left;
+        KernJob.wHeight   = bottom - top;
+        KernJob.dwColor   = 0xFFFFFFFF;
+        Kern.pfnXor();
+    } else {
+        PatFillRect( left, top, right - left, bottom - top );
+    }
+}
+
+/* Draw a rectangular frame with the given horizontal and vertical
+ * thickness using PATCOPY, PATINVERT, or DSTINVERT. All four edges are
+ * drawn with the cursor excluded once. Anything unusual is passed to
+ * the DIB Engine.
+ */
+BOOL WINAPI __loadds FastBorder( LPRECT lpRect, WORD wBorderWidth, WORD wBorderHeight, DWORD dwRop3,
+                                 LPDIBENGINE lpDestDev, LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode,
+                                 LPRECT lpClipRect )
+{
+    WORD    wFlags = lpDestDev->deFlags;
+    int     left, top, right, bottom;
+    int     w = wBorderWidth;
+    int     h = wBorderHeight;
+    RECT    rcAccess;
+
+    if( !(wFlags & VRAM) || (wFlags & BUSY) || lpDestDev->deBitsPixel < 8 )
+        goto punt;
+
+    left   = lpRect->left;
+    top    = lpRect->top;
+    right  = lpRect->right;
+    bottom = lpRect->bottom;
+    if( left >= right || top >= bottom )
+        return( TRUE );
+
+    wBorderRop = (BYTE)(dwRop3 >> 16);
+    switch( wBorderRop ) {
+    case ROP_PATCOPY:
+        if( !PatSelect( lpDestDev, lpPBrush, lpDrawMode ) )
+            goto punt;
+        break;
+    case ROP_PATINVERT:
+        if( !PatSelectXor( lpDestDev, lpPBrush ) )
+            goto punt;
+        break;
+    case ROP_DSTINVERT:
+        if( !Kern.pfnXor )
+            goto punt;
+        break;
+    default:
+        goto punt;
+    }
+
+    /* Inverting edges must not overlap, or they would cancel out. */
+    if( w <= 0 || h <= 0 || ((right - left < 2 * w || bottom - top < 2 * h) && wBorderRop != ROP_PATCOPY) )
+        goto punt;
+
+    rcAccess = *lpRect;
+    if( lpClipRect ) {
+        if( rcAccess.left < lpClipRect->left )
+            rcAccess.left = lpClipRect->left;
+        if( rcAccess.top < lpClipRect->top )
+            rcAccess.top = lpClipRect->top;
+        if( rcAccess.right > lpClipRect->right )
+            rcAccess.right = lpClipRect->right;
+        if( rcAccess.bottom > lpClipRect->bottom )
+            rcAccess.bottom = lpClipRect->bottom;
+        if( rcAccess.left >= rcAccess.right || rcAccess.top >= rcAccess.bottom )
+            return( TRUE );
+    }
+
+    lpBorderDev  = lpDestDev;
+    lpBorderClip = lpClipRect;
+    ((BEGINACCESSPROC)lpDestDev->deBeginAccess)( lpDestDev, rcAccess.left, rcAccess.top,
+                                                 rcAccess.right - 1, rcAccess.bottom - 1, CURSOREXCLUDE );
+    BorderEdge( left, top, right, top + h );                    /* Top. */
+    BorderEdge( left, bottom - h, right, bottom );              /* Bottom. */
+    BorderEdge( left, top + h, left + w, bottom - h );          /* Left. */
+    BorderEdge( right - w, top + h, right, bottom - h );        /* Right. */
+    ((ENDACCESSPROC)lpDestDev->deEndAccess)( lpDestDev, CURSOREXCLUDE );
+    return( TRUE );
+
+punt:
+    return( DIB_FastBorder( lpRect, wBorderWidth, wBorderHeight, dwRop3, lpDestDev,
+                            lpPBrush, lpDrawMode, lpClipRect ) );
+}
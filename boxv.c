@@ -29,6 +29,65 @@ THE SOFTWARE.
 #include "boxv_io.h"    /* I/O access layer, host specific. */
 
 
+/* Standard modes reported by BOXV_mode_enumerate(). The mode numbers
+ * follow the VBE BIOS where it has one, see boxv.h.
+ */
+static BOXV_mode_t mode_list[] = {
+    { 0x150,  320,  200,  8 },
+    { 0x10E,  320,  200, 16 },
+    { 0x10F,  320,  200, 24 },
+    { 0x140,  320,  200, 32 },
+    { 0x151,  320,  240,  8 },
+    { 0x152,  320,  240, 16 },
+    { 0x153,  320,  240, 24 },
+    { 0x154,  320,  240, 32 },
+    { 0x155,  400,  300,  8 },
+    { 0x156,  400,  300, 16 },
+    { 0x157,  400,  300, 24 },
+    { 0x158,  400,  300, 32 },
+    { 0x159,  512,  384,  8 },
+    { 0x15A,  512,  384, 16 },
+    { 0x15B,  512,  384, 24 },
+    { 0x15C,  512,  384, 32 },
+    { 0x100,  640,  400,  8 },
+    { 0x101,  640,  480,  8 },
+    { 0x111,  640,  480, 16 },
+    { 0x112,  640,  480, 24 },
+    { 0x129,  640,  480, 32 },
+    { 0x103,  800,  600,  8 },
+    { 0x114,  800,  600, 16 },
+    { 0x115,  800,  600, 24 },
+    { 0x12E,  800,  600, 32 },
+    { 0x105, 1024,  768,  8 },
+    { 0x117, 1024,  768, 16 },
+    { 0x118, 1024,  768, 24 },
+    { 0x138, 1024,  768, 32 },
+    { 0x107, 1280, 1024,  8 },
+    { 0x11A, 1280, 1024, 16 },
+    { 0x11B, 1280, 1024, 24 },
+    { 0x13D, 1280, 1024, 32 },
+    { 0x145, 1600, 1200,  8 },
+    { 0x146, 1600, 1200, 16 },
+    { 0x147, 1600, 1200, 24 },
+    { 0x148, 1600, 1200, 32 },
+    { 0x160, 1280,  800,  8 },
+    { 0x161, 1280,  800, 16 },
+    { 0x162, 1280,  800, 24 },
+    { 0x163, 1280,  800, 32 },
+    { 0x164, 1440,  900,  8 },
+    { 0x165, 1440,  900, 16 },
+    { 0x166, 1440,  900, 24 },
+    { 0x167, 1440,  900, 32 },
+    { 0x168, 1680, 1050,  8 },
+    { 0x169, 1680, 1050, 16 },
+    { 0x16A, 1680, 1050, 24 },
+    { 0x16B, 1680, 1050, 32 },
+    { 0x16C, 1920, 1200,  8 },
+    { 0x16D, 1920, 1200, 16 },
+    { 0x16E, 1920, 1200, 24 },
+    { 0x16F, 1920, 1200, 32 }
+};
+
 /* Write a single value to an indexed register at a specified
  * index. Suitable for the CRTC or graphics controller.
  */
@@ -93,6 +152,19 @@ int BOXV_ext_mode_set( void *cx, int xres, int yres, int bpp, int v_xres, int v_
     return( 0 );
 }
 
+/* Set the display start within the virtual screen, e.g. for panning.
+ * Only the offset registers are written; nothing else changes.
+ * Returns non-zero on failure.
+ */
+int BOXV_pan_set( void *cx, int x, int y )
+{
+    vid_outw( cx, VBE_DISPI_IOPORT_INDEX, VBE_DISPI_INDEX_X_OFFSET );
+    vid_outw( cx, VBE_DISPI_IOPORT_DATA, x );
+    vid_outw( cx, VBE_DISPI_IOPORT_INDEX, VBE_DISPI_INDEX_Y_OFFSET );
+    vid_outw( cx, VBE_DISPI_IOPORT_DATA, y );
+    return( 0 );
+}
+
 /* Program the DAC. Each of the 'count' entries is 4 bytes in size,
  * red/green/blue/unused.
  * Returns non-zero on failure.
@@ -138,6 +210,52 @@ int BOXV_detect( void *cx, unsigned long *vram_size )
     return( boxv_id );
 }
 
+/* Query the largest resolution and color depth the adapter supports.
+ * Returns non-zero on failure, i.e. if the adapter cannot report them.
+ */
+int BOXV_get_caps( void *cx, int *max_xres, int *max_yres, int *max_bpp )
+{
+    v_word      boxv_id;
+    v_word      enable;
+
+    vid_outw( cx, VBE_DISPI_IOPORT_INDEX, VBE_DISPI_INDEX_ID );
+    boxv_id = vid_inw( cx, VBE_DISPI_IOPORT_DATA );
+    if( boxv_id < VBE_DISPI_ID3 || boxv_id > VBE_DISPI_ID6 )
+        return( -1 );
+
+    /* With GETCAPS set, the resolution registers read back as maximums.
+     * The other enable bits must be preserved, or the mode would be
+     * switched off (or set) as a side effect.
+     */
+    vid_outw( cx, VBE_DISPI_IOPORT_INDEX, VBE_DISPI_INDEX_ENABLE );
+    enable = vid_inw( cx, VBE_DISPI_IOPORT_DATA ) & ~VBE_DISPI_GETCAPS;
+    vid_outw( cx, VBE_DISPI_IOPORT_DATA, enable | VBE_DISPI_GETCAPS );
+
+    vid_outw( cx, VBE_DISPI_IOPORT_INDEX, VBE_DISPI_INDEX_XRES );
+    *max_xres = vid_inw( cx, VBE_DISPI_IOPORT_DATA );
+    vid_outw( cx, VBE_DISPI_IOPORT_INDEX, VBE_DISPI_INDEX_YRES );
+    *max_yres = vid_inw( cx, VBE_DISPI_IOPORT_DATA );
+    vid_outw( cx, VBE_DISPI_IOPORT_INDEX, VBE_DISPI_INDEX_BPP );
+    *max_bpp = vid_inw( cx, VBE_DISPI_IOPORT_DATA );
+
+    vid_outw( cx, VBE_DISPI_IOPORT_INDEX, VBE_DISPI_INDEX_ENABLE );
+    vid_outw( cx, VBE_DISPI_IOPORT_DATA, enable );
+    return( 0 );
+}
+
+/* Call 'cb' for each of the standard modes, until it returns zero. The
+ * modes are not checked against the adapter's capabilities.
+ */
+void BOXV_mode_enumerate( void *cx, int (cb)( void *cx, BOXV_mode_t *mode ) )
+{
+    int     i;
+
+    for( i = 0; i < sizeof( mode_list ) / sizeof( mode_list[0] ); ++i ) {
+        if( !cb( cx, &mode_list[i] ) )
+            break;
+    }
+}
+
 /* Disable extended mode and place the hardware into a VGA compatible state.
  * Returns non-zero on failure.
  */
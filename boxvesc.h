@@ -0,0 +1,95 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+/* Driver specific escapes, see Control(). Applications, including Win32
+ * ones through ExtEscape, can use these. Coordinates are screen pixels,
+ * right and bottom edges are exclusive.
+ */
+
+#define BOXV_ESC_DAMAGE_RING    0x6B01  /* Get the shared damage ring. */
+#define BOXV_ESC_DAMAGE_READ    0x6B02  /* Read damage since a sequence number. */
+#define BOXV_ESC_SNAPSHOT       0x6B03  /* Copy screen contents. */
+
+typedef struct {
+    short   left;
+    short   top;
+    short   right;
+    short   bottom;
+} BOXV_RECT;
+
+/* The damage ring lives in shared memory. The driver stores rectangle
+ * number n in Rects[n % wSize] and then sets dwHead to n + 1. A reader
+ * remembers the dwHead value it has seen; if dwHead moved by more than
+ * wSize since then, or wGeneration changed, the whole screen must be
+ * refreshed. The last rectangle may still be growing until the next one
+ * is stored; BOXV_ESC_DAMAGE_READ publishes it.
+ */
+#define BOXV_DAMAGE_SIG     0x474D4442UL    /* 'BDMG' */
+#define BOXV_DAMAGE_SIZE    256
+
+typedef struct {
+    DWORD       dwSignature;    /* BOXV_DAMAGE_SIG. */
+    DWORD       dwHead;         /* Rectangles stored so far. */
+    WORD        wSize;          /* Entries in Rects. */
+    WORD        wGeneration;    /* Changes with the display mode. */
+    WORD        wWidth;         /* Screen size. */
+    WORD        wHeight;
+    BOXV_RECT   Rects[BOXV_DAMAGE_SIZE];
+} BOXV_DAMAGE_RING;
+
+/* BOXV_ESC_DAMAGE_RING output. */
+typedef struct {
+    DWORD       dwLinear;       /* Flat address of the ring. */
+    DWORD       dwFarPtr;       /* 16:16 address of the ring. */
+} BOXV_DAMAGE_INFO;
+
+/* BOXV_ESC_DAMAGE_READ takes the DWORD head value returned by the
+ * previous call (zero the first time) as input, and fills in this.
+ * Both damage escapes return -1 if the output buffer is too small.
+ */
+#define BOXV_DAMAGE_READMAX 64
+#define BOXV_DAMAGE_ALL     0x0001  /* Refresh everything; no rectangles. */
+
+typedef struct {
+    DWORD       dwHead;         /* Input for the next call. */
+    WORD        wCount;         /* Rectangles returned. */
+    WORD        wFlags;         /* BOXV_DAMAGE_xxx. */
+    BOXV_RECT   Rects[BOXV_DAMAGE_READMAX];
+} BOXV_DAMAGE_READ;
+
+/* BOXV_ESC_SNAPSHOT input. The rectangle must lie within the screen and
+ * is stored top row first. The destination is the escape's output
+ * buffer, or if dwLinear is not zero, memory at that flat address in the
+ * calling process; it must lie between 4MB and 2GB. Returns 1 on success, -1 on bad parameters or an
+ * output buffer too small for the rectangle.
+ */
+#define BOXV_SNAP_NOCURSOR  0x0001  /* Leave the cursor out. */
+
+typedef struct {
+    BOXV_RECT   rc;             /* Screen rectangle. */
+    WORD        wBpp;           /* 24, 32, or 0 for the screen format. */
+    WORD        wFlags;         /* BOXV_SNAP_xxx. */
+    DWORD       dwPitch;        /* Destination bytes per row. */
+    DWORD       dwLinear;       /* Destination flat address, or zero. */
+} BOXV_SNAPSHOT;
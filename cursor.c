@@ -0,0 +1,652 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* Software cursor. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+#include <string.h>
+
+/* The cursor shape is converted to screen format once, when it is set.
+ * The pixels under the cursor are kept in system memory, so hiding the
+ * cursor never reads VRAM, and moving it only reads the screen area newly
+ * covered. When the old and new positions overlap, the union is composed
+ * in a work buffer and only the pixels that change are written.
+ *
+ * MoveCursor() (and possibly SetCursor()) runs at interrupt time. The
+ * screen is only touched when no foreground drawing is in progress and
+ * the PDevice is not BUSY; otherwise the new position is recorded and
+ * the cursor is redrawn when the surface access ends, or by CheckCursor().
+ *
+ * Shapes this code does not handle are given to the DIB Engine.
+ */
+
+#define CUR_MAX     32      /* Largest cursor drawn here. */
+#define CUR_BYTES   4       /* Largest pixel size. */
+#define CUR_DIBMAX  64      /* Largest cursor the DIB Engine draws. */
+
+/* Layout of the cursor segment. */
+#define CS_AND      0
+#define CS_XOR      (CS_AND + CUR_MAX * CUR_MAX * CUR_BYTES)
+#define CS_SAVE     (CS_XOR + CUR_MAX * CUR_MAX * CUR_BYTES)
+#define CS_WORK     (CS_SAVE + CUR_MAX * CUR_MAX * CUR_BYTES)
+#define CS_SIZE     (CS_WORK + 4 * CUR_MAX * CUR_MAX * CUR_BYTES)
+
+/* Converted shapes are cached for animated cursors, which cycle through
+ * a few shapes many times per second. Each cache slot holds an AND and an
+ * XOR image laid out like CS_AND and CS_XOR.
+ */
+#define CUR_CACHE   6
+#define CC_SLOT     (2 * CUR_MAX * CUR_MAX * CUR_BYTES)
+
+#pragma pack( push, 1 )
+
+/* Cursor shape passed to SetCursor(), followed by the AND mask and the
+ * XOR mask or color image.
+ */
+typedef struct {
+    short   csHotX;
+    short   csHotY;
+    short   csWidth;
+    short   csHeight;
+    short   csWidthBytes;       /* Bytes per AND mask row. */
+    BYTE    csPlanes;
+    BYTE    csBitsPixel;        /* XOR image format, 1 or screen bpp. */
+} CURSHAPE;
+
+#pragma pack( pop )
+
+typedef CURSHAPE FAR *LPCURSHAPE;
+
+typedef struct {
+    DWORD       dwHash;             /* Hash of the shape bits. */
+    WORD        wBpp;               /* Screen bpp, zero if unused. */
+    CURSHAPE    Shape;              /* Shape header. */
+} CURCACHE;
+
+static WORD     wCurSel;            /* Cursor segment, zero if none. */
+static WORD     wCurW;              /* Shape size. */
+static WORD     wCurH;
+static int      xCurHot;            /* Shape hot spot. */
+static int      yCurHot;
+static WORD     wCurBytes;          /* Bytes per pixel. */
+static int      xCur;               /* Current hot spot position. */
+static int      yCur;
+static RECT     rcShown;            /* Cursor rectangle on the screen. */
+static WORD     wSavePitch;         /* Save-under row length. */
+static BYTE     bCurShape;          /* Shape is set. */
+static BYTE     bCurDib;            /* Shape is drawn by the DIB Engine. */
+static BYTE     bCurShown;          /* Cursor is on the screen. */
+static BYTE     bCurPending;        /* Cursor must be redrawn. */
+static int      xDibMarked;         /* DIB Engine cursor position last */
+static int      yDibMarked;         /* marked dirty in the shadow. */
+static BYTE     bDibPending;        /* DIB Engine cursor moved since. */
+
+WORD            wAccessLock;        /* Screen access nesting. */
+static WORD     wCacheSel;          /* Shape cache segment, zero if none. */
+static WORD     wCacheNext;         /* Next cache slot to replace. */
+static CURCACHE CurCache[CUR_CACHE];
+
+/* Clip a rectangle to the screen. Returns zero if nothing is left. */
+static int CurClip( LPRECT lprc )
+{
+    if( lprc->left < 0 )
+        lprc->left = 0;
+    if( lprc->top < 0 )
+        lprc->top = 0;
+    if( lprc->right > lpDriverPDevice->deWidth )
+        lprc->right = lpDriverPDevice->deWidth;
+    if( lprc->bottom > lpDriverPDevice->deHeight )
+        lprc->bottom = lpDriverPDevice->deHeight;
+    return( lprc->left < lprc->right && lprc->top < lprc->bottom );
+}
+
+/* Store the parts of rectangle a not covered by b in lpOut. Returns the
+ * number of rectangles, at most four.
+ */
+static int CurSubtract( LPRECT a, LPRECT b, LPRECT lpOut )
+{
+    RECT    rc = *a;
+    int     n = 0;
+
+    if( b->left >= rc.right || b->right <= rc.left || b->top >= rc.bottom || b->bottom <= rc.top ) {
+        *lpOut = rc;
+        return( 1 );
+    }
+    if( b->top > rc.top ) {
+        lpOut[n] = rc;
+        lpOut[n++].bottom = b->top;
+        rc.top = b->top;
+    }
+    if( b->bottom < rc.bottom ) {
+        lpOut[n] = rc;
+        lpOut[n++].top = b->bottom;
+        rc.bottom = b->bottom;
+    }
+    if( b->left > rc.left ) {
+        lpOut[n] = rc;
+        lpOut[n++].right = b->left;
+    }
+    if( b->right < rc.right ) {
+        lpOut[n] = rc;
+        lpOut[n++].left = b->right;
+    }
+    return( n );
+}
+
+/* Copy a screen rectangle to or from a buffer in the cursor segment. The
+ * buffer starts at wOfs, holds wPitch bytes per row and its first pixel
+ * corresponds to screen position (xOrg,yOrg).
+ */
+static void CurXfer( int bToScreen, LPRECT lprc, WORD wOfs, WORD wPitch, int xOrg, int yOrg )
+{
+    LPDIBENGINE lpDev = lpDriverPDevice;
+    DWORD       dwScr;
+    WORD        wBuf;
+
+    dwScr = lpDev->deBitsOffset + (long)lprc->top * lpDev->deDeltaScan + lprc->left * wCurBytes;
+    wBuf  = wOfs + (lprc->top - yOrg) * wPitch + (lprc->left - xOrg) * wCurBytes;
+    if( bToScreen ) {
+        ShadowDirty( lprc->left, lprc->top, lprc->right - 1, lprc->bottom - 1 );
+        KernJob.wDstSel   = lpDev->deBitsSelector;
+        KernJob.dwDstOfs  = dwScr;
+        KernJob.lDstPitch = lpDev->deDeltaScan;
+        KernJob.wSrcSel   = wCurSel;
+        KernJob.dwSrcOfs  = wBuf;
+        KernJob.lSrcPitch = wPitch;
+    } else {
+        KernJob.wDstSel   = wCurSel;
+        KernJob.dwDstOfs  = wBuf;
+        KernJob.lDstPitch = wPitch;
+        KernJob.wSrcSel   = lpDev->deBitsSelector;
+        KernJob.dwSrcOfs  = dwScr;
+        KernJob.lSrcPitch = lpDev->deDeltaScan;
+    }
+    KernJob.wWidth  = lprc->right - lprc->left;
+    KernJob.wHeight = lprc->bottom - lprc->top;
+    Kern.pfnCopy();
+}
+
+/* Copy a rectangle between two buffers in the cursor segment. */
+static void CurCopy( LPRECT lprc, WORD wDst, WORD wDstPitch, int xDst, int yDst,
+                     WORD wSrc, WORD wSrcPitch, int xSrc, int ySrc )
+{
+    BYTE __far  *lpSeg = wCurSel :> 0;
+    WORD        wBytes = (lprc->right - lprc->left) * wCurBytes;
+    int         y;
+
+    wDst += (lprc->top - yDst) * wDstPitch + (lprc->left - xDst) * wCurBytes;
+    wSrc += (lprc->top - ySrc) * wSrcPitch + (lprc->left - xSrc) * wCurBytes;
+    for( y = lprc->top; y < lprc->bottom; ++y ) {
+        _fmemcpy( lpSeg + wDst, lpSeg + wSrc, wBytes );
+        wDst += wDstPitch;
+        wSrc += wSrcPitch;
+    }
+}
+
+/* Remove the cursor from the screen. */
+static void CurHide( void )
+{
+    KERNJOB SavedJob;
+    RECT    rc;
+
+    if( !bCurShown )
+        return;
+    bCurShown = 0;
+    /* When BUSY, the screen contents are not ours to restore. */
+    if( lpDriverPDevice->deFlags & BUSY )
+        return;
+    rc = rcShown;
+    if( !CurClip( &rc ) )
+        return;
+    SavedJob = KernJob;
+    CurXfer( 1, &rc, CS_SAVE, wSavePitch, rcShown.left, rcShown.top );
+    KernJob = SavedJob;
+}
+
+/* Draw the cursor at the current position, removing it from the old one. */
+static void CurDraw( void )
+{
+    BYTE __far  *lpSeg;
+    KERNJOB     SavedJob;
+    RECT        rcNew, rcNewC, rcOldC, rcU;
+    RECT        rcPart[4];
+    WORD        wPitch, wShapePitch;
+    WORD        wW, wA, wBytes;
+    int         i, n, y;
+
+    rcNew.left   = xCur - xCurHot;
+    rcNew.top    = yCur - yCurHot;
+    rcNew.right  = rcNew.left + wCurW;
+    rcNew.bottom = rcNew.top + wCurH;
+
+    /* Only keep the old cursor in the work area if the two overlap. */
+    if( bCurShown && (rcShown.left >= rcNew.right || rcShown.right <= rcNew.left
+                      || rcShown.top >= rcNew.bottom || rcShown.bottom <= rcNew.top) )
+        CurHide();
+
+    rcNewC = rcNew;
+    if( !CurClip( &rcNewC ) ) {
+        CurHide();
+        return;
+    }
+
+    SavedJob = KernJob;
+    lpSeg = wCurSel :> 0;
+    wShapePitch = wCurW * wCurBytes;
+
+    /* The work area covers the union of both rectangles. */
+    rcU = rcNewC;
+    rcOldC.left = rcOldC.top = rcOldC.right = rcOldC.bottom = 0;
+    if( bCurShown ) {
+        rcOldC = rcShown;
+        CurClip( &rcOldC );
+        if( rcOldC.left < rcU.left )
+            rcU.left = rcOldC.left;
+        if( rcOldC.top < rcU.top )
+            rcU.top = rcOldC.top;
+        if( rcOldC.right > rcU.right )
+            rcU.right = rcOldC.right;
+        if( rcOldC.bottom > rcU.bottom )
+            rcU.bottom = rcOldC.bottom;
+        /* Background under the old cursor comes from the save-under. */
+        CurCopy( &rcOldC, CS_WORK, (rcU.right - rcU.left) * wCurBytes, rcU.left, rcU.top,
+                 CS_SAVE, wSavePitch, rcShown.left, rcShown.top );
+    }
+    wPitch = (rcU.right - rcU.left) * wCurBytes;
+
+    /* Read only what the old cursor did not cover. */
+    n = CurSubtract( &rcNewC, &rcOldC, rcPart );
+    for( i = 0; i < n; ++i )
+        CurXfer( 0, &rcPart[i], CS_WORK, wPitch, rcU.left, rcU.top );
+
+    /* That is the new save-under. */
+    CurCopy( &rcNewC, CS_SAVE, wShapePitch, rcNew.left, rcNew.top,
+             CS_WORK, wPitch, rcU.left, rcU.top );
+
+    /* Apply the shape. */
+    wBytes = (rcNewC.right - rcNewC.left) * wCurBytes;
+    wW = CS_WORK + (rcNewC.top - rcU.top) * wPitch + (rcNewC.left - rcU.left) * wCurBytes;
+    wA = (rcNewC.top - rcNew.top) * wShapePitch + (rcNewC.left - rcNew.left) * wCurBytes;
+    for( y = rcNewC.top; y < rcNewC.bottom; ++y ) {
+        BYTE __far  *lpW = lpSeg + wW;
+        BYTE __far  *lpA = lpSeg + CS_AND + wA;
+        BYTE __far  *lpX = lpSeg + CS_XOR + wA;
+        WORD        w;
+
+        for( w = wBytes; w; --w, ++lpW )
+            *lpW = (*lpW & *lpA++) ^ *lpX++;
+        wW += wPitch;
+        wA += wShapePitch;
+    }
+
+    /* Write the new cursor and whatever of the old one it does not cover. */
+    CurXfer( 1, &rcNewC, CS_WORK, wPitch, rcU.left, rcU.top );
+    if( bCurShown ) {
+        n = CurSubtract( &rcOldC, &rcNewC, rcPart );
+        for( i = 0; i < n; ++i )
+            CurXfer( 1, &rcPart[i], CS_WORK, wPitch, rcU.left, rcU.top );
+    }
+
+    rcShown    = rcNew;
+    wSavePitch = wShapePitch;
+    bCurShown  = 1;
+    KernJob    = SavedJob;
+}
+
+/* Bring the screen up to date with the cursor state. The caller makes
+ * sure no one else is accessing the screen.
+ */
+static void CurUpdate( void )
+{
+    if( lpDriverPDevice->deFlags & BUSY ) {
+        bCurPending = 1;
+        return;
+    }
+    bCurPending = 0;
+    if( bCurShape && !bCurDib )
+        CurDraw();
+    else
+        CurHide();
+}
+
+/* Hash the shape header and cBytes bytes of bits following it. */
+static DWORD CurHash( LPCURSHAPE lpShape, WORD cBytes )
+{
+    LPBYTE  lpb = (LPBYTE)lpShape;
+    WORD    wSum = 0;
+    WORD    wRot = 0;
+
+    cBytes += sizeof( CURSHAPE );
+    while( cBytes-- ) {
+        wSum += *lpb;
+        wRot  = ((wRot << 3) | (wRot >> 13)) ^ *lpb++;
+    }
+    return( ((DWORD)wSum << 16) | wRot );
+}
+
+/* Look for a converted shape in the cache and load it. Returns zero if
+ * it is not there.
+ */
+static int CurCacheLoad( LPCURSHAPE lpShape, WORD wBpp, DWORD dwHash, WORD wImage )
+{
+    BYTE __far  *lpSeg = wCurSel :> 0;
+    BYTE __far  *lpSlot;
+    int         i;
+
+    if( !wCacheSel )
+        return( 0 );
+    for( i = 0; i < CUR_CACHE; ++i ) {
+        if( CurCache[i].wBpp == wBpp && CurCache[i].dwHash == dwHash
+          && !_fmemcmp( &CurCache[i].Shape, lpShape, sizeof( CURSHAPE ) ) ) {
+            lpSlot = (BYTE __far *)(wCacheSel :> 0) + (WORD)i * CC_SLOT;
+            _fmemcpy( lpSeg + CS_AND, lpSlot, wImage );
+            _fmemcpy( lpSeg + CS_XOR, lpSlot + (CS_XOR - CS_AND), wImage );
+            return( 1 );
+        }
+    }
+    return( 0 );
+}
+
+/* Add the shape just converted to the cache. */
+static void CurCacheStore( LPCURSHAPE lpShape, WORD wBpp, DWORD dwHash, WORD wImage )
+{
+    BYTE __far  *lpSeg = wCurSel :> 0;
+    BYTE __far  *lpSlot;
+    CURCACHE    *pEntry;
+
+    if( !wCacheSel ) {
+        HGLOBAL hMem = GlobalAlloc( GMEM_FIXED | GMEM_SHARE, (DWORD)CUR_CACHE * CC_SLOT );
+
+        if( !hMem )
+            return;
+        wCacheSel = (__segment)GlobalLock( hMem );
+    }
+    pEntry = &CurCache[wCacheNext];
+    lpSlot = (BYTE __far *)(wCacheSel :> 0) + wCacheNext * CC_SLOT;
+    _fmemcpy( lpSlot, lpSeg + CS_AND, wImage );
+    _fmemcpy( lpSlot + (CS_XOR - CS_AND), lpSeg + CS_XOR, wImage );
+    pEntry->dwHash = dwHash;
+    pEntry->wBpp   = wBpp;
+    pEntry->Shape  = *lpShape;
+    wCacheNext = (wCacheNext + 1) % CUR_CACHE;
+}
+
+/* Forget all cached shapes, e.g. after a mode change. */
+void CursorCacheFlush( void )
+{
+    int     i;
+
+    for( i = 0; i < CUR_CACHE; ++i )
+        CurCache[i].wBpp = 0;
+}
+
+/* Convert a cursor shape to screen format. Returns zero if the shape has
+ * to be drawn by the DIB Engine.
+ */
+static int CurConvert( LPCURSHAPE lpShape )
+{
+    LPDIBENGINE lpDev = lpDriverPDevice;
+    BYTE __far  *lpSeg;
+    LPBYTE      lpAnd, lpXor;
+    WORD        wBpp = lpDev->deBitsPixel;
+    WORD        wXorPitch, wDst, wImage;
+    DWORD       dwWhite, dwHash;
+    WORD        x, y, b;
+
+    if( wBpp < 8 || !Kern.pfnCopy )
+        return( 0 );
+    if( lpShape->csWidth <= 0 || lpShape->csWidth > CUR_MAX || lpShape->csHeight <= 0 || lpShape->csHeight > CUR_MAX )
+        return( 0 );
+    if( lpShape->csBitsPixel != 1 && lpShape->csBitsPixel != wBpp )
+        return( 0 );
+
+    if( !wCurSel ) {
+        /* Fixed memory owned by a DLL is page locked, which makes it
+         * safe to use at interrupt time.
+         */
+        HGLOBAL hMem = GlobalAlloc( GMEM_FIXED | GMEM_SHARE, CS_SIZE );
+
+        if( !hMem )
+            return( 0 );
+        wCurSel = (__segment)GlobalLock( hMem );
+    }
+
+    lpSeg     = wCurSel :> 0;
+    lpAnd     = (LPBYTE)(lpShape + 1);
+    lpXor     = lpAnd + lpShape->csWidthBytes * lpShape->csHeight;
+    wXorPitch = lpShape->csBitsPixel == 1 ? lpShape->csWidthBytes
+                                          : ((lpShape->csWidth * wBpp + 15) >> 4) << 1;
+    wCurBytes = wBpp >> 3;
+    wImage    = lpShape->csWidth * lpShape->csHeight * wCurBytes;
+    dwHash    = CurHash( lpShape, (lpShape->csWidthBytes + wXorPitch) * lpShape->csHeight );
+    if( CurCacheLoad( lpShape, wBpp, dwHash, wImage ) )
+        goto done;
+
+    if( wBpp == 8 )
+        dwWhite = 0xFF;
+    else if( wBpp == 16 )
+        dwWhite = (lpDev->deFlags & FIVE6FIVE) ? 0xFFFF : 0x7FFF;
+    else
+        dwWhite = 0xFFFFFF;
+
+    wDst = 0;
+    for( y = 0; y < lpShape->csHeight; ++y ) {
+        for( x = 0; x < lpShape->csWidth; ++x ) {
+            BYTE    bMask = 0x80 >> (x & 7);
+            BYTE    bAnd  = (lpAnd[x >> 3] & bMask) ? 0xFF : 0;
+            DWORD   dwXor = (lpXor[x >> 3] & bMask) ? dwWhite : 0;
+
+            for( b = 0; b < wCurBytes; ++b, ++wDst ) {
+                lpSeg[CS_AND + wDst] = bAnd;
+                if( lpShape->csBitsPixel == 1 ) {
+                    lpSeg[CS_XOR + wDst] = (BYTE)dwXor;
+                    dwXor >>= 8;
+                } else {
+                    /* Color images are already in screen format. */
+                    lpSeg[CS_XOR + wDst] = lpXor[x * wCurBytes + b];
+                }
+            }
+        }
+        lpAnd += lpShape->csWidthBytes;
+        lpXor += wXorPitch;
+    }
+    CurCacheStore( lpShape, wBpp, dwHash, wImage );
+
+done:
+    wCurW   = lpShape->csWidth;
+    wCurH   = lpShape->csHeight;
+    xCurHot = lpShape->csHotX;
+    yCurHot = lpShape->csHotY;
+    return( 1 );
+}
+
+/* Mark the shadow framebuffer dirty where the DIB Engine's cursor was
+ * when this was last done and where it is now, and optionally copy those
+ * areas to the screen. The DIB Engine does not report where it drew, so
+ * a generous area is assumed. The caller holds the access lock; a move at
+ * interrupt time meanwhile sets bDibPending again.
+ */
+static void CurDibDirty( int bFlush )
+{
+    int     x, y;
+
+    bDibPending = 0;
+    x = xCur;
+    y = yCur;
+    ShadowDirty( xDibMarked - CUR_DIBMAX, yDibMarked - CUR_DIBMAX, xDibMarked + CUR_DIBMAX, yDibMarked + CUR_DIBMAX );
+    ShadowDirty( x - CUR_DIBMAX, y - CUR_DIBMAX, x + CUR_DIBMAX, y + CUR_DIBMAX );
+    if( bFlush ) {
+        ShadowFlushRect( xDibMarked - CUR_DIBMAX, yDibMarked - CUR_DIBMAX, xDibMarked + CUR_DIBMAX, yDibMarked + CUR_DIBMAX );
+        ShadowFlushRect( x - CUR_DIBMAX, y - CUR_DIBMAX, x + CUR_DIBMAX, y + CUR_DIBMAX );
+    }
+    xDibMarked = x;
+    yDibMarked = y;
+}
+
+/* Surface access callbacks, see deBeginAccess. The DIB Engine's own
+ * callbacks are still called for the cursors it draws.
+ */
+void WINAPI __loadds CursorBeginAccess( LPDIBENGINE lpDev, WORD wLeft, WORD wTop, WORD wRight,
+                                       WORD wBottom, WORD wFlags )
+{
+    DIB_BeginAccess( lpDev, wLeft, wTop, wRight, wBottom, wFlags );
+    ++wAccessLock;
+    ShadowDirty( (short)wLeft, (short)wTop, (short)wRight, (short)wBottom );
+    DamageAdd( (short)wLeft, (short)wTop, (short)wRight, (short)wBottom );
+    if( (wFlags & CURSOREXCLUDE) && bCurShown ) {
+        if( (short)wLeft < rcShown.right && (short)wRight >= rcShown.left
+          && (short)wTop < rcShown.bottom && (short)wBottom >= rcShown.top )
+            CurHide();
+    }
+}
+
+/* Drop the access lock, first catching up on cursor work deferred while
+ * it was held.
+ */
+static void CurRelease( void )
+{
+    if( wAccessLock == 1 && (bCurPending || (bCurShape && !bCurShown)) )
+        CurUpdate();
+    if( wAccessLock == 1 && bDibPending )
+        CurDibDirty( 0 );
+    --wAccessLock;
+}
+
+void WINAPI __loadds CursorEndAccess( LPDIBENGINE lpDev, WORD wFlags )
+{
+    CurRelease();
+    DIB_EndAccess( lpDev, wFlags );
+}
+
+/* Take the access lock and keep the cursor out of a rectangle which is
+ * only read. Unlike CursorBeginAccess, nothing is marked dirty or damaged
+ * beyond what removing the cursor itself changes.
+ */
+void CursorExclude( LPDIBENGINE lpDev, int iLeft, int iTop, int iRight, int iBottom )
+{
+    if( bCurDib )
+        DIB_BeginAccess( lpDev, iLeft, iTop, iRight, iBottom, CURSOREXCLUDE );
+    ++wAccessLock;
+    if( bCurShown && iLeft < rcShown.right && iRight >= rcShown.left
+      && iTop < rcShown.bottom && iBottom >= rcShown.top )
+        CurHide();
+}
+
+/* Undo CursorExclude. */
+void CursorUnexclude( LPDIBENGINE lpDev )
+{
+    CurRelease();
+    if( bCurDib )
+        DIB_EndAccess( lpDev, CURSOREXCLUDE );
+}
+
+/* The screen contents were lost, e.g. after a mode set. */
+void CursorReset( void )
+{
+    bCurShown   = 0;
+    bCurPending = 1;
+}
+
+/* Exported as DISPLAY.102 */
+void WINAPI __loadds SetCursor( LPVOID lpCursorShape )
+{
+    LPCURSHAPE  lpShape = lpCursorShape;
+    BYTE        bDib = 0;
+
+    if( lpShape && !CurConvert( lpShape ) )
+        bDib = 1;
+
+    if( bDib || bCurDib )
+        DIB_SetCursorExt( lpDriverPDevice, bDib ? lpCursorShape : NULL );
+    bCurDib   = bDib;
+    bCurShape = lpShape != NULL;
+
+    if( wAccessLock ) {
+        bCurPending = 1;
+        return;
+    }
+    ++wAccessLock;
+    CurUpdate();
+    --wAccessLock;
+}
+
+/* Exported as DISPLAY.103 */
+void WINAPI __loadds MoveCursor( WORD absX, WORD absY )
+{
+    RECT    rcOld;
+
+    PanFollow( (short)absX, (short)absY );
+    if( bCurDib ) {
+        DIB_MoveCursorExt( lpDriverPDevice, absX, absY );
+        xCur = (short)absX;
+        yCur = (short)absY;
+        if( wAccessLock ) {
+            bDibPending = 1;
+            return;
+        }
+        ++wAccessLock;
+        CurDibDirty( 1 );
+        --wAccessLock;
+        return;
+    }
+    xCur = (short)absX;
+    yCur = (short)absY;
+    if( wAccessLock || !bCurShape ) {
+        bCurPending = 1;
+        return;
+    }
+    ++wAccessLock;
+    rcOld = rcShown;
+    CurUpdate();
+    /* A cursor move is a sync point, but only for the cursor. */
+    ShadowFlushRect( rcOld.left, rcOld.top, rcOld.right - 1, rcOld.bottom - 1 );
+    ShadowFlushRect( rcShown.left, rcShown.top, rcShown.right - 1, rcShown.bottom - 1 );
+    --wAccessLock;
+}
+
+/* Exported as DISPLAY.104 */
+void WINAPI __loadds CheckCursor( void )
+{
+    if( !wEnabled )
+        return;
+    if( bCurDib ) {
+        DIB_CheckCursorExt( lpDriverPDevice );
+        if( bDibPending && !wAccessLock ) {
+            ++wAccessLock;
+            CurDibDirty( 0 );
+            --wAccessLock;
+        }
+        return;
+    }
+    if( bCurPending && !wAccessLock ) {
+        ++wAccessLock;
+        CurUpdate();
+        --wAccessLock;
+    }
+}
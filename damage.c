@@ -0,0 +1,176 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* Screen damage tracking for applications. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+#include "boxvesc.h"
+
+/* Every surface access (see CursorBeginAccess) reports the accessed
+ * rectangle. Overlapping or touching rectangles are merged into a pending
+ * one, which is stored in the shared ring once a rectangle that cannot be
+ * merged comes along, or when an application reads the damage. Tracking
+ * starts with the first damage escape; the cursor is not included.
+ */
+
+static HGLOBAL                  hRing;
+static BOXV_DAMAGE_RING FAR     *lpRing;
+static RECT                     rcPending;
+static BYTE                     bPending;
+
+/* Store the pending rectangle in the ring. */
+static void DamagePublish( void )
+{
+    BOXV_RECT FAR   *lpRc;
+
+    if( !bPending )
+        return;
+    lpRc = &lpRing->Rects[(WORD)lpRing->dwHead % BOXV_DAMAGE_SIZE];
+    lpRc->left   = rcPending.left;
+    lpRc->top    = rcPending.top;
+    lpRc->right  = rcPending.right;
+    lpRc->bottom = rcPending.bottom;
+    ++lpRing->dwHead;
+    bPending = 0;
+}
+
+/* Record damage to an inclusive rectangle. */
+void DamageAdd( int iLeft, int iTop, int iRight, int iBottom )
+{
+    if( !lpRing )
+        return;
+    if( iLeft < 0 )
+        iLeft = 0;
+    if( iTop < 0 )
+        iTop = 0;
+    if( iRight >= (int)wScreenX )
+        iRight = wScreenX - 1;
+    if( iBottom >= (int)wScreenY )
+        iBottom = wScreenY - 1;
+    if( iLeft > iRight || iTop > iBottom )
+        return;
+
+    if( bPending ) {
+        if( iLeft <= rcPending.right && iRight >= rcPending.left
+          && iTop <= rcPending.bottom && iBottom >= rcPending.top ) {
+            if( iLeft < rcPending.left )
+                rcPending.left = iLeft;
+            if( iTop < rcPending.top )
+                rcPending.top = iTop;
+            if( iRight >= rcPending.right )
+                rcPending.right = iRight + 1;
+            if( iBottom >= rcPending.bottom )
+                rcPending.bottom = iBottom + 1;
+            return;
+        }
+        DamagePublish();
+    }
+    rcPending.left   = iLeft;
+    rcPending.top    = iTop;
+    rcPending.right  = iRight + 1;
+    rcPending.bottom = iBottom + 1;
+    bPending = 1;
+}
+
+/* The display mode changed; everything is damaged. */
+void DamageReset( void )
+{
+    if( !lpRing )
+        return;
+    bPending = 0;
+    ++lpRing->wGeneration;
+    lpRing->wWidth  = wScreenX;
+    lpRing->wHeight = wScreenY;
+    DamageAdd( 0, 0, wScreenX - 1, wScreenY - 1 );
+}
+
+/* Start tracking. Returns zero if the ring cannot be allocated. */
+static int DamageStart( void )
+{
+    if( lpRing )
+        return( 1 );
+    hRing = GlobalAlloc( GMEM_FIXED | GMEM_SHARE | GMEM_ZEROINIT, sizeof( BOXV_DAMAGE_RING ) );
+    if( !hRing )
+        return( 0 );
+    lpRing = (LPVOID)GlobalLock( hRing );
+    lpRing->dwSignature = BOXV_DAMAGE_SIG;
+    lpRing->wSize       = BOXV_DAMAGE_SIZE;
+    DamageReset();
+    return( 1 );
+}
+
+/* Check that a caller's buffer holds at least wSize bytes. */
+static int DamageBufOK( LPVOID lpBuf, WORD wSize )
+{
+    DWORD   dwLimit;
+
+    if( !lpBuf )
+        return( 0 );
+    dwLimit = GetSelectorLimit( (__segment)lpBuf );
+    return( (WORD)(DWORD)lpBuf <= dwLimit && wSize - 1 <= dwLimit - (WORD)(DWORD)lpBuf );
+}
+
+/* Handle the damage escapes. Returns the Control() result. */
+int DamageEscape( WORD wFunction, LPVOID lpInData, LPVOID lpOutData )
+{
+    BOXV_DAMAGE_INFO FAR    *lpInfo = lpOutData;
+    BOXV_DAMAGE_READ FAR    *lpRead = lpOutData;
+    DWORD                   dwSeen;
+    DWORD                   dwNew;
+    WORD                    i;
+
+    switch( wFunction ) {
+    case BOXV_ESC_DAMAGE_RING:
+        if( !DamageBufOK( lpOutData, sizeof( BOXV_DAMAGE_INFO ) ) || !DamageStart() )
+            return( -1 );
+        lpInfo->dwLinear = GetSelectorBase( (__segment)lpRing ) + (WORD)(DWORD)lpRing;
+        lpInfo->dwFarPtr = (DWORD)lpRing;
+        return( 1 );
+
+    case BOXV_ESC_DAMAGE_READ:
+        if( !DamageBufOK( lpOutData, sizeof( BOXV_DAMAGE_READ ) ) || !DamageStart() )
+            return( -1 );
+        if( lpInData && !DamageBufOK( lpInData, sizeof( DWORD ) ) )
+            return( -1 );
+        DamagePublish();
+        dwSeen = lpInData ? *(DWORD FAR *)lpInData : 0;
+        dwNew  = lpRing->dwHead - dwSeen;
+        lpRead->dwHead = lpRing->dwHead;
+        lpRead->wCount = 0;
+        lpRead->wFlags = 0;
+        if( !dwSeen || dwNew > BOXV_DAMAGE_READMAX ) {
+            lpRead->wFlags = BOXV_DAMAGE_ALL;
+            return( 1 );
+        }
+        for( i = 0; i < (WORD)dwNew; ++i )
+            lpRead->Rects[i] = lpRing->Rects[(WORD)(dwSeen + i) % BOXV_DAMAGE_SIZE];
+        lpRead->wCount = (WORD)dwNew;
+        return( 1 );
+    }
+    return( 0 );
+}
@@ -68,7 +68,7 @@ typedef LPINT  LPSHORT;
 
 /* DIB Engine functions. */
 /* NB: Based on DDK documentation which may be inaccurate. */
-extern void     WINAPI  DIB_Control( void );
+extern WORD     WINAPI  DIB_Control( LPPDEVICE lpDevice, WORD wFunction, LPVOID lpInData, LPVOID lpOutData );
 extern WORD     WINAPI  DIB_EnumObjExt( LPPDEVICE lpDestDev, WORD wStyle, FARPROC lpCallbackFunc,
                                         LPVOID lpClientData, LPPDEVICE lpDisplayDev );
 extern VOID     WINAPI  DIB_CheckCursorExt( LPPDEVICE lpDevice );
@@ -83,6 +83,9 @@ extern WORD     WINAPI  DIB_RealizeObjectExt( LPPDEVICE lpDestDev, WORD wStyle,
 extern BOOL     WINAPI  DIB_BitBlt( LPPDEVICE lpDestDev, WORD wDestX, WORD wDestY, LPPDEVICE lpSrcDev,
                                     WORD wSrcX, WORD wSrcY, WORD wXext, WORD wYext, DWORD dwRop3,
                                     LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode );
+extern BOOL     WINAPI  DIB_FastBorder( LPRECT lpRect, WORD wBorderWidth, WORD wBorderHeight, DWORD dwRop3,
+                                        LPPDEVICE lpDestDev, LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode,
+                                        LPRECT lpClipRect );
 extern BOOL     WINAPI  DIB_BitmapBits( LPPDEVICE lpDevice, DWORD fFlags, DWORD dwCount, LPSTR lpBits );
 extern VOID     WINAPI  DIB_DibBlt( LPPDEVICE lpBitmap, WORD fGet, WORD iStart, WORD cScans, LPSTR lpDIBits,
                                     LPBITMAPINFO lpBitmapInfo, LPDRAWMODE lpDrawMode, LPINT lpTranslate );
@@ -98,7 +101,7 @@ extern BOOL     WINAPI  DIB_StretchBlt( LPPDEVICE lpDestDev, WORD wDestX, WORD w
                                         LPDRAWMODE lpDrawMode, LPRECT lpClipRect );
 extern BOOL     WINAPI  DIB_StretchDIBits( LPPDEVICE lpDestDev, WORD fGet, WORD wDestX, WORD wDestY, WORD wDestWidth,
                                            WORD wDestHeight, WORD wSrcX, WORD wSrcY, WORD wSrcWidth, WORD wSrcHeight,
-                                           VOID *lpBits, LPBITMAPINFO lpInfo, LPINT lpTranslate, DWORD dwRop3,
+                                           LPVOID lpBits, LPBITMAPINFO lpInfo, LPINT lpTranslate, DWORD dwRop3,
                                            LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode, LPRECT lpClipRect );
 extern DWORD    WINAPI  DIB_ExtTextOut( LPPDEVICE lpDestDev, WORD wDestXOrg, WORD wDestYOrg, LPRECT lpClipRect,
                                         LPSTR lpString, int wCount, LPFONTINFO lpFontInfo, LPDRAWMODE lpDrawMode,
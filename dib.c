@@ -0,0 +1,241 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* DIB to screen conversions. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+#define ROP_SRCCOPY     0xCC
+
+/* True color DIBs going to an 8bpp screen are converted here. With a
+ * palette, each pixel is mapped through the inverse colormap (see
+ * palmap.c). Without one, the screen has a fixed color table and the
+ * pixels are first offset by an 8x8 ordered dither threshold, then mapped
+ * through the same inverse colormap built for the fixed colors.
+ */
+
+/* Spread of the dither thresholds: the distance between neighboring
+ * levels of the color cube in the fixed color table (see Enable).
+ */
+#define DITHER_SPREAD   (255 / (CUBE_LEVELS - 1))
+
+/* Bayer matrix, values 0-63. */
+static const BYTE Bayer8[64] = {
+     0, 32,  8, 40,  2, 34, 10, 42,
+    48, 16, 56, 24, 50, 18, 58, 26,
+    12, 44,  4, 36, 14, 46,  6, 38,
+    60, 28, 52, 20, 62, 30, 54, 22,
+     3, 35, 11, 43,  1, 33,  9, 41,
+    51, 19, 59, 27, 49, 17, 57, 25,
+    15, 47,  7, 39, 13, 45,  5, 37,
+    63, 31, 55, 23, 61, 29, 53, 21
+};
+
+/* Used by the dither kernels. A component c with threshold t becomes
+ * DitherClamp[c + DitherTab[t]], a 5-bit value.
+ */
+BYTE    DitherTab[64];
+BYTE    DitherClamp[256 + DITHER_SPREAD];
+
+static void DitherInit( void )
+{
+    int     i, c;
+
+    for( i = 0; i < 64; ++i )
+        DitherTab[i] = Bayer8[i] * DITHER_SPREAD / 64;
+    for( i = 0; i < 256 + DITHER_SPREAD; ++i ) {
+        c = i - DITHER_SPREAD / 2;
+        if( c < 0 )
+            c = 0;
+        else if( c > 255 )
+            c = 255;
+        DitherClamp[i] = c >> 3;
+    }
+}
+
+/* Select the conversion kernel for a DIB going to the screen, or return
+ * NULL if the DIB Engine has to do it.
+ */
+static KERNPROC DibSelect( LPDIBENGINE lpDev, LPBITMAPINFOHEADER lpHdr, LPINT lpTranslate )
+{
+    static BYTE bDitherInit;
+    WORD        wFlags = lpDev->deFlags;
+
+    if( !(wFlags & VRAM) || (wFlags & BUSY) || lpDev->deBitsPixel != 8 || lpTranslate )
+        return( NULL );
+    if( lpHdr->biCompression != BI_RGB || lpHdr->biPlanes != 1 )
+        return( NULL );
+    if( (long)lpHdr->biHeight <= 0 || lpHdr->biHeight > 0x7FFF || !lpHdr->biWidth || lpHdr->biWidth > 0x7FFF )
+        return( NULL );
+    if( lpHdr->biBitCount != 24 && lpHdr->biBitCount != 32 )
+        return( NULL );
+
+    KernJob.wAuxSel = InvMapUpdate();
+    if( !KernJob.wAuxSel )
+        return( NULL );
+
+    if( wPalettized )
+        return( lpHdr->biBitCount == 24 ? KernMap24to8 : KernMap32to8 );
+
+    if( !bDitherInit ) {
+        DitherInit();
+        bDitherInit = 1;
+    }
+    return( lpHdr->biBitCount == 24 ? KernDither24to8 : KernDither32to8 );
+}
+
+/* Draw the screen rectangle lprc from the DIB. The top row of the
+ * rectangle comes from scan line wScan (counted from the start of lpBits)
+ * and the left column from pixel wSrcX.
+ */
+static void DibDraw( LPDIBENGINE lpDev, KERNPROC pfnConv, LPRECT lprc, LPSTR lpBits,
+                     LPBITMAPINFOHEADER lpHdr, WORD wScan, WORD wSrcX )
+{
+    DWORD   dwStride = ((lpHdr->biWidth * lpHdr->biBitCount + 31) >> 5) << 2;
+
+    KernJob.wDstSel   = lpDev->deBitsSelector;
+    KernJob.dwDstOfs  = lpDev->deBitsOffset + (long)lprc->top * lpDev->deDeltaScan + lprc->left;
+    KernJob.lDstPitch = lpDev->deDeltaScan;
+    KernJob.wSrcSel   = (__segment)lpBits;
+    KernJob.dwSrcOfs  = (WORD)(DWORD)lpBits + wScan * dwStride + wSrcX * (lpHdr->biBitCount >> 3);
+    KernJob.lSrcPitch = -(long)dwStride;    /* Bottom-up. */
+    KernJob.wWidth    = lprc->right - lprc->left;
+    KernJob.wHeight   = lprc->bottom - lprc->top;
+    KernJob.wPatRow   = lprc->top & 7;
+    KernJob.wPatCol   = lprc->left & 7;
+
+    ((BEGINACCESSPROC)lpDev->deBeginAccess)( lpDev, lprc->left, lprc->top, lprc->right - 1,
+                                             lprc->bottom - 1, CURSOREXCLUDE );
+    pfnConv();
+    ((ENDACCESSPROC)lpDev->deEndAccess)( lpDev, CURSOREXCLUDE );
+}
+
+/* Clip a screen rectangle to the screen and the clip rectangle, if any.
+ * Returns zero if nothing is left.
+ */
+static int DibClip( LPDIBENGINE lpDev, LPRECT lprc, LPRECT lpClipRect )
+{
+    if( lprc->left < 0 )
+        lprc->left = 0;
+    if( lprc->top < 0 )
+        lprc->top = 0;
+    if( lprc->right > lpDev->deWidth )
+        lprc->right = lpDev->deWidth;
+    if( lprc->bottom > lpDev->deHeight )
+        lprc->bottom = lpDev->deHeight;
+    if( lpClipRect ) {
+        if( lprc->left < lpClipRect->left )
+            lprc->left = lpClipRect->left;
+        if( lprc->top < lpClipRect->top )
+            lprc->top = lpClipRect->top;
+        if( lprc->right > lpClipRect->right )
+            lprc->right = lpClipRect->right;
+        if( lprc->bottom > lpClipRect->bottom )
+            lprc->bottom = lpClipRect->bottom;
+    }
+    return( lprc->left < lprc->right && lprc->top < lprc->bottom );
+}
+
+/* Set DIB bits on the screen.
+ *
+ * (X,Y) is the top left corner of the entire DIB on the screen. The DIB
+ * is bottom-up, so scan line s lies on row Y + biHeight - 1 - s. The
+ * buffer holds cScans scan lines, starting with scan line iScan.
+ */
+WORD WINAPI __loadds DibToDevice( LPDIBENGINE lpDestDev, WORD X, WORD Y, WORD iScan, WORD cScans,
+                                  LPRECT lpClipRect, LPDRAWMODE lpDrawMode, LPSTR lpDIBits,
+                                  LPBITMAPINFO lpBitmapInfo, LPINT lpTranslate )
+{
+    LPBITMAPINFOHEADER  lpHdr = &lpBitmapInfo->bmiHeader;
+    KERNPROC            pfnConv;
+    RECT                rc;
+    int                 x = (short)X;
+    int                 y = (short)Y;
+    int                 iHeight;
+
+    if( !cScans )
+        goto punt;
+    pfnConv = DibSelect( lpDestDev, lpHdr, lpTranslate );
+    if( !pfnConv )
+        goto punt;
+
+    /* Rows covered by the scan lines in the buffer. */
+    iHeight   = (int)lpHdr->biHeight;
+    rc.left   = x;
+    rc.right  = x + (int)lpHdr->biWidth;
+    rc.bottom = y + iHeight - iScan;
+    rc.top    = rc.bottom - cScans;
+    if( DibClip( lpDestDev, &rc, lpClipRect ) )
+        DibDraw( lpDestDev, pfnConv, &rc, lpDIBits, lpHdr,
+                 y + iHeight - 1 - rc.top - iScan, rc.left - x );
+    return( cScans );
+
+punt:
+    return( DIB_DibToDevice( lpDestDev, X, Y, iScan, cScans, lpClipRect, lpDrawMode,
+                             lpDIBits, lpBitmapInfo, lpTranslate ) );
+}
+
+/* Stretch DIB bits to the screen. Only unstretched SRCCOPY is handled.
+ * The source rectangle is given in DIB coordinates, with (wSrcX,wSrcY)
+ * being its lower left corner.
+ */
+BOOL WINAPI __loadds StretchDIBits( LPDIBENGINE lpDestDev, WORD fGet, WORD wDestX, WORD wDestY, WORD wDestWidth,
+                                    WORD wDestHeight, WORD wSrcX, WORD wSrcY, WORD wSrcWidth, WORD wSrcHeight,
+                                    LPVOID lpBits, LPBITMAPINFO lpInfo, LPINT lpTranslate, DWORD dwRop3,
+                                    LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode, LPRECT lpClipRect )
+{
+    LPBITMAPINFOHEADER  lpHdr = &lpInfo->bmiHeader;
+    KERNPROC            pfnConv;
+    RECT                rc;
+    int                 x = (short)wDestX;
+    int                 y = (short)wDestY;
+
+    if( fGet || (BYTE)(dwRop3 >> 16) != ROP_SRCCOPY || wDestWidth != wSrcWidth || wDestHeight != wSrcHeight )
+        goto punt;
+    if( (short)wSrcWidth <= 0 || (short)wSrcHeight <= 0 )
+        goto punt;
+    pfnConv = DibSelect( lpDestDev, lpHdr, lpTranslate );
+    if( !pfnConv )
+        goto punt;
+    if( (DWORD)wSrcX + wSrcWidth > lpHdr->biWidth || (DWORD)wSrcY + wSrcHeight > lpHdr->biHeight )
+        goto punt;
+
+    rc.left   = x;
+    rc.top    = y;
+    rc.right  = x + wDestWidth;
+    rc.bottom = y + wDestHeight;
+    if( DibClip( lpDestDev, &rc, lpClipRect ) )
+        DibDraw( lpDestDev, pfnConv, &rc, lpBits, lpHdr,
+                 wSrcY + wSrcHeight - 1 - (rc.top - y), wSrcX + (rc.left - x) );
+    return( wSrcHeight );
+
+punt:
+    return( DIB_StretchDIBits( lpDestDev, fGet, wDestX, wDestY, wDestWidth, wDestHeight,
+                               wSrcX, wSrcY, wSrcWidth, wSrcHeight, lpBits, lpInfo,
+                               lpTranslate, dwRop3, lpPBrush, lpDrawMode, lpClipRect ) );
+}
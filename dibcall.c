@@ -27,6 +27,7 @@ THE SOFTWARE.
 #include <gdidefs.h>
 #include <dibeng.h>
 #include "minidrv.h"
+#include "boxvesc.h"
 
 /*
  * What's this all about? Most of the required exported driver functions can
@@ -44,26 +45,41 @@ THE SOFTWARE.
  */
 
 
-/* Exported as DISPLAY.104 */
-void WINAPI __loadds CheckCursor( void )
+/* Handle the driver specific escapes, see boxvesc.h. Everything else
+ * goes to the DIB Engine.
+ * Exported as DISPLAY.3
+ */
+WORD WINAPI __loadds Control( LPPDEVICE lpDevice, WORD wFunction, LPVOID lpInData, LPVOID lpOutData )
 {
-    if( wEnabled ) {
-        DIB_CheckCursorExt( lpDriverPDevice );
+    switch( wFunction ) {
+    case QUERYESCSUPPORT:
+        if( lpInData ) {
+            switch( *(LPWORD)lpInData ) {
+            case BOXV_ESC_DAMAGE_RING:
+            case BOXV_ESC_DAMAGE_READ:
+            case BOXV_ESC_SNAPSHOT:
+                return( 1 );
+            }
+        }
+        break;
+    case BOXV_ESC_DAMAGE_RING:
+    case BOXV_ESC_DAMAGE_READ:
+        return( DamageEscape( wFunction, lpInData, lpOutData ) );
+    case BOXV_ESC_SNAPSHOT:
+        return( SnapEscape( lpInData, lpOutData ) );
     }
+    return( DIB_Control( lpDevice, wFunction, lpInData, lpOutData ) );
 }
 
-/* If there is no hardware screen-to-screen BitBlt, there's no point in
- * this and we can just forward BitBlt to the DIB Engine.
+/* If there is no accelerated BitBlt (in hardware or compiled, see rop3.c),
+ * there's no point in this and we can just forward BitBlt to the DIB Engine.
  */
 #ifdef HWBLT
 
-extern BOOL WINAPI (* BitBltDevProc)( LPDIBENGINE, WORD, WORD, LPPDEVICE, WORD, WORD,
-                                      WORD, WORD, DWORD, LPBRUSH, LPDRAWMODE );
-
-/* See if a hardware BitBlt can be done. */
-BOOL WINAPI BitBlt( LPDIBENGINE lpDestDev, WORD wDestX, WORD wDestY, LPPDEVICE lpSrcDev,
-                    WORD wSrcX, WORD wSrcY, WORD wXext, WORD wYext, DWORD dwRop3,
-                    LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode )
+/* See if an accelerated BitBlt can be done. */
+BOOL WINAPI __loadds BitBlt( LPDIBENGINE lpDestDev, WORD wDestX, WORD wDestY, LPPDEVICE lpSrcDev,
+                             WORD wSrcX, WORD wSrcY, WORD wXext, WORD wYext, DWORD dwRop3,
+                             LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode )
 {
     WORD    dstFlags = lpDestDev->deFlags;
 
@@ -73,7 +89,7 @@ BOOL WINAPI BitBlt( LPDIBENGINE lpDestDev, WORD wDestX, WORD wDestY, LPPDEVICE l
          * and destination device are identical.
          */
         if( !(dstFlags & PALETTE_XLAT) || (lpDestDev == lpSrcDev) ) {
-            /* If there is a hardware acceleration callback, use it. */
+            /* If there is an acceleration callback, use it. */
             if( BitBltDevProc ) {
                 return( BitBltDevProc( lpDestDev, wDestX, wDestY, lpSrcDev, wSrcX, wSrcY, wXext, wYext, dwRop3, lpPBrush, lpDrawMode ) );
             }
@@ -71,37 +71,25 @@ assume	ds:nothing, es:nothing
 ;; Thunks that push an additional parameter.
 ;; Sorted by ordinal number.
 DIBTHK	EnumObj, 		_lpDriverPDevice
-DIBTHK	RealizeObject,		_lpDriverPDevice
 DIBTHK	DibBlt,			_wPalettized
 DIBTHK	GetPalette,		_lpDriverPDevice
-DIBTHK	SetPaletteTranslate,	_lpDriverPDevice
 DIBTHK	GetPaletteTranslate,	_lpDriverPDevice
-DIBTHK	UpdateColors,		_lpDriverPDevice
-DIBTHK	SetCursor,		_lpDriverPDevice
-DIBTHK	MoveCursor,		_lpDriverPDevice
 
 ;; Forwarders that simply jump to the DIB Engine.
 ;; Sorted by ordinal number.
 ifndef HWBLT
 DIBFWD	BitBlt
 endif
-DIBFWD	ColorInfo
-DIBFWD	Control
 DIBFWD	EnumDFonts
-DIBFWD	Output
 DIBFWD	Pixel
 DIBFWD	Strblt
 DIBFWD	ScanLR
 DIBFWD	DeviceMode
-DIBFWD	ExtTextOut
 DIBFWD	GetCharWidth
 DIBFWD	DeviceBitmap
-DIBFWD	FastBorder
 DIBFWD	SetAttribute
 DIBFWD	CreateDIBitmap
-DIBFWD	DibToDevice
 DIBFWD	StretchBlt
-DIBFWD	StretchDIBits
 DIBFWD	SelectBitmap
 DIBFWD	BitmapBits
 DIBFWD	Inquire
@@ -43,6 +43,7 @@ THE SOFTWARE.
 
 LPDIBENGINE lpDriverPDevice = 0;    /* This device's PDEV that's passed to GDI. */
 WORD wEnabled = 0;                  /* Is this device enabled? */
+WORD wBigFonts = 0;                 /* GDI passes fonts in 3.0 format. */
 RGBQUAD FAR *lpColorTable = 0;      /* Current color table. */
 
 static BYTE bReEnabling = 0;        /* Set when re-enabling PDEV. */
@@ -156,6 +157,7 @@ UINT WINAPI __loadds Enable( LPVOID lpDevice, UINT style, LPSTR lpDeviceType,
         LPDIBENGINE     lpEng = lpDevice;
         LPBITMAPINFO    lpInfo;
         WORD            wFlags;
+        WORD            wPitch;
         DWORD           dwRet;
 
         /* Initialize the PDEVICE. */
@@ -219,6 +221,17 @@ UINT WINAPI __loadds Enable( LPVOID lpDevice, UINT style, LPSTR lpDeviceType,
                     for( i = 10; i < 246; ++i )
                         lpColorTable[i] = DIB8ColorTable2[0];
 
+                    /* Without a palette nothing else will fill them, so
+                     * put a color cube there for the dither (see dib.c).
+                     */
+                    if( !wPalettized ) {
+                        for( i = 0; i < CUBE_LEVELS * CUBE_LEVELS * CUBE_LEVELS; ++i ) {
+                            lpColorTable[10 + i].rgbRed   = i / (CUBE_LEVELS * CUBE_LEVELS) * 255 / (CUBE_LEVELS - 1);
+                            lpColorTable[10 + i].rgbGreen = i / CUBE_LEVELS % CUBE_LEVELS * 255 / (CUBE_LEVELS - 1);
+                            lpColorTable[10 + i].rgbBlue  = i % CUBE_LEVELS * 255 / (CUBE_LEVELS - 1);
+                        }
+                    }
+
                     _fmemcpy( &lpColorTable[246], DIB8ColorTable3, sizeof( DIB8ColorTable3 ) );
                 }
             }
@@ -230,16 +243,37 @@ UINT WINAPI __loadds Enable( LPVOID lpDevice, UINT style, LPSTR lpDeviceType,
 
         /* Call the DIB Engine to set up the PDevice. */
         dbg_printf( "lpInfo=%WP lpDevice=%WP lpColorTable=%WP wFlags=%X ScreenSelector=%X\n", lpInfo, lpDevice, lpColorTable, wFlags, ScreenSelector );
-        dwRet = CreateDIBPDeviceX( lpInfo, lpDevice, ScreenSelector :> 0, wFlags );
+        /* Draw into the shadow framebuffer, if there is one. A pixel
+         * doubled surface is half as wide as the screen and cannot be
+         * drawn without one; GDI already knows its size, so the mode
+         * fails rather than changing under it.
+         */
+        wPitch = wDoubled ? CalcPitch( wScreenX, wBpp ) : wScreenPitchBytes;
+        if( ShadowAlloc( wScreenX, wScreenY, wBpp, wPitch ) ) {
+            dwRet = CreateDIBPDeviceX( lpInfo, lpDevice, wShadowSel :> 0, wFlags );
+        } else if( wDoubled ) {
+            dbg_printf( "Enable: no shadow framebuffer for pixel doubling!\n" );
+            return( 0 );
+        } else {
+            wPitch = wScreenPitchBytes;
+            dwRet = CreateDIBPDeviceX( lpInfo, lpDevice, ScreenSelector :> 0, wFlags );
+        }
         if( !dwRet ) {
             dbg_printf( "Enable: CreateDIBPDevice failed!\n" );
             return( 0 );
         }
         dbg_printf( "Enable: CreateDIBPDevice returned %lX\n", dwRet );
 
+        /* The DIB Engine derives the pitch from the width; the screen's
+         * may be padded further (see CalcPitch).
+         */
+        lpEng->deWidthBytes = wPitch;
+        lpEng->deDeltaScan  = wPitch;
+        DamageReset();
+
         /* Now fill out the begin/end access callbacks. */
-        lpEng->deBeginAccess = DIB_BeginAccess;
-        lpEng->deEndAccess   = DIB_EndAccess;
+        lpEng->deBeginAccess = CursorBeginAccess;
+        lpEng->deEndAccess   = CursorEndAccess;
 
         /* Program the DAC in non-direct color modes. */
         if( wBpp <= 8 ) {
@@ -256,10 +290,12 @@ UINT WINAPI __loadds Enable( LPVOID lpDevice, UINT style, LPSTR lpDeviceType,
                 break;
             }
             SetRAMDAC_far( 0, wPalCnt, lpColorTable );
+            InvMapInvalidate( 0, wPalCnt );
         }
 
         if( !bReEnabling ) {
             HookInt2Fh();
+            Rop3Init();
         }
         wEnabled = 1;
         return( 1 );
@@ -269,6 +305,7 @@ UINT WINAPI __loadds Enable( LPVOID lpDevice, UINT style, LPSTR lpDeviceType,
 
         /* Start with passing down to the DIB engine. It will set dpCurves through dpStyleLen. */
         DIB_Enable( lpDevice, style, lpDeviceType, lpOutputFile, lpStuff );
+        wBigFonts = (lpInfo->dpRaster & RC_BIGFONT) != 0;
 
         /* Fill out some static data. Note that some fields are set by the DIB Engine
          * and we don't touch them (curves, lines, polygons etc.).
@@ -282,33 +319,33 @@ UINT WINAPI __loadds Enable( LPVOID lpDevice, UINT style, LPSTR lpDeviceType,
         lpInfo->dpNumFonts   = 0;
 
         /* Now set the fields that depend on current mode. */
-        lpInfo->dpHorzRes = wScrX;
-        lpInfo->dpVertRes = wScrY;
+        lpInfo->dpHorzRes = wVirtX;
+        lpInfo->dpVertRes = wVirtY;
 
         lpInfo->dpMLoWin.xcoord = DISPLAY_HORZ_MM * 10;
         lpInfo->dpMLoWin.ycoord = DISPLAY_VERT_MM * 10;
-        lpInfo->dpMLoVpt.xcoord = wScrX;
-        lpInfo->dpMLoVpt.ycoord = -wScrY;
+        lpInfo->dpMLoVpt.xcoord = wVirtX;
+        lpInfo->dpMLoVpt.ycoord = -wVirtY;
 
         lpInfo->dpMHiWin.xcoord = DISPLAY_HORZ_MM * 100;
         lpInfo->dpMHiWin.ycoord = DISPLAY_VERT_MM * 100;
-        lpInfo->dpMHiVpt.xcoord = wScrX;
-        lpInfo->dpMHiVpt.ycoord = -wScrY;
+        lpInfo->dpMHiVpt.xcoord = wVirtX;
+        lpInfo->dpMHiVpt.ycoord = -wVirtY;
 
         /* These calculations are a wild guess and probably don't matter. */
         lpInfo->dpELoWin.xcoord = DISPLAY_SIZE_EN;
         lpInfo->dpELoWin.ycoord = DISPLAY_SIZE_EN;
-        lpInfo->dpELoVpt.xcoord = wScrX / 5;
+        lpInfo->dpELoVpt.xcoord = wVirtX / 5;
         lpInfo->dpELoVpt.ycoord = -lpInfo->dpELoVpt.xcoord;
 
         lpInfo->dpELoWin.xcoord = DISPLAY_SIZE_EN * 5;
         lpInfo->dpELoWin.ycoord = DISPLAY_SIZE_EN * 5;
-        lpInfo->dpEHiVpt.xcoord = wScrX / 10;
+        lpInfo->dpEHiVpt.xcoord = wVirtX / 10;
         lpInfo->dpEHiVpt.ycoord = -lpInfo->dpEHiVpt.xcoord;
 
         lpInfo->dpTwpWin.xcoord = DISPLAY_SIZE_TWP;
         lpInfo->dpTwpWin.ycoord = DISPLAY_SIZE_TWP;
-        lpInfo->dpTwpVpt.xcoord = wScrX / 10;
+        lpInfo->dpTwpVpt.xcoord = wVirtX / 10;
         lpInfo->dpTwpVpt.ycoord = -lpInfo->dpTwpVpt.xcoord;
 
         /* Update more GDIINFO bits. */
@@ -388,21 +425,26 @@ UINT WINAPI __loadds ReEnable( LPVOID lpDevice, LPGDIINFO lpInfo )
 
     dbg_printf( "ReEnable: lpDevice=%WP lpInfo=%WP wScreenX=%u wScreenY=%u\n", lpDevice, lpInfo, wScreenX, wScreenY );
 
-    /* Figure out the new mode. */
-    ReadDisplayConfig();
+    /* Figure out the new mode. Unlike the desktop set up at boot, a
+     * mode switched to at run time may be a low resolution one, usually
+     * for a full-screen game (ChangeDisplaySettings).
+     */
+    ReadDisplayConfig( 1 );
     dbg_printf( "ReEnable: wScreenX=%u wScreenY=%u wBpp=%u\n", wScreenX, wScreenY, wBpp );
 
     /* Let Enable know it doesn't need to do everything. */
     bReEnabling = 1;
 
     /* Don't let the cursor mess with things. */
-    DIB_BeginAccess( lpDevice, 0, 0, wScreenX - 1, wScreenY - 1, CURSOREXCLUDE );
+    CursorBeginAccess( lpDevice, 0, 0, wScreenX - 1, wScreenY - 1, CURSOREXCLUDE );
 
     /* Create a new PDevice and set the new mode. Returns zero on failure. */
     rc = Enable( lpDevice, 0, NULL, NULL, NULL );
 
     /* Drawing the cursor is safe again. */
-    DIB_EndAccess( lpDevice, CURSOREXCLUDE );
+    CursorReset();
+    CursorCacheFlush();
+    CursorEndAccess( lpDevice, CURSOREXCLUDE );
 
     if( rc ) {
         /* Enable succeeded, fill out GDIINFO. */
@@ -441,6 +483,7 @@ UINT WINAPI __loadds Disable( LPVOID lpDevice )
     /* Start disabling and mark the PDevice busy. */
     wEnabled = 0;
     lpEng->deFlags |= BUSY; /// @todo Does this need to be a locked op?
+    ShadowStop();
 
     /* Re-enable I/O trapping before we start setting a standard VGA mode. */
     int_2Fh( START_IO_TRAP );
@@ -454,5 +497,8 @@ UINT WINAPI __loadds Disable( LPVOID lpDevice )
     /* And unhook INT 2F. */
     UnhookInt2Fh();
 
+    /* Compiled BitBlt code is no longer needed. */
+    Rop3Term();
+
     return( 1 );
 }
@@ -37,9 +37,12 @@ UINT WINAPI GlobalSmartPageLock( HGLOBAL hglb );
 
 WORD    wScrX       = 640;  /* Current X resolution. */
 WORD    wScrY       = 480;  /* Current Y resolution. */
+WORD    wVirtX      = 640;  /* Desktop width, at least wScrX. */
+WORD    wVirtY      = 480;  /* Desktop height, at least wScrY. */
 WORD    wDpi        = 96;   /* Current DPI setting. */
 WORD    wBpp        = 8;    /* Current BPP setting. */
 WORD    wPalettized = 0;    /* Non-zero if palettized. */
+WORD    wCpuFeatures = 0;   /* CPU_xxx flags. */
 
 WORD    OurVMHandle   = 0;          /* The current VM's ID. */
 DWORD   VDDEntryPoint = 0;          /* The VDD entry point. */
@@ -123,9 +126,10 @@ CONFIGRET static _near _cdecl CM_Get_Res_Des_Data(
     return( wRc );
 }
 
-/* Read the display settings from SYSTEM.INI or Registry.
+/* Read the display settings from SYSTEM.INI or Registry. Resolutions
+ * below 640x480 are only accepted if bLowRes is set, see ReEnable.
  */
-DEVNODE ReadDisplayConfig( void )
+DEVNODE ReadDisplayConfig( WORD bLowRes )
 {
     WORD        wX, wY;
     UINT        bIgnoreRegistry;
@@ -148,6 +152,21 @@ DEVNODE ReadDisplayConfig( void )
 
     bIgnoreRegistry = GetPrivateProfileInt( "display", "IgnoreRegistry", 0, "system.ini" );
 
+    /* Optionally draw into a shadow framebuffer in system memory. */
+    wShadowFB = GetPrivateProfileInt( "display", "shadowfb", 0, "system.ini" );
+
+    /* Optionally scan out every GDI pixel as 2x2 (implies shadowfb). */
+    wPixelDouble = GetPrivateProfileInt( "display", "pixeldouble", 0, "system.ini" );
+
+    /* Scanline pitch alignment, a power of two. */
+    wPitchAlign = GetPrivateProfileInt( "display", "pitch_align", 64, "system.ini" );
+    if( wPitchAlign < 4 || wPitchAlign > 1024 || (wPitchAlign & (wPitchAlign - 1)) )
+        wPitchAlign = 4;
+
+    /* Optionally make the desktop larger than the screen and pan. */
+    wVirtX = GetPrivateProfileInt( "display", "virtual_x", 0, "system.ini" );
+    wVirtY = GetPrivateProfileInt( "display", "virtual_y", 0, "system.ini" );
+
     dwRc = CallVDDGetDispConf( VDD_GET_DISPLAY_CONFIG, sizeof( DispInfo ), &DispInfo );
     if( (dwRc != VDD_GET_DISPLAY_CONFIG) && !dwRc ) {
         devNode = (DEVNODE)DispInfo.diDevNodeHandle;
@@ -174,12 +193,13 @@ DEVNODE ReadDisplayConfig( void )
     mode.yRes = wScrY;
     mode.bpp  = wBpp;
 
-    if( !FixModeInfo( &mode ) ) {
+    if( !FixModeInfo( &mode, bLowRes ) ) {
         /* Values were changed. */
         wScrX = mode.xRes;
         wScrY = mode.yRes;
         wBpp  = mode.bpp;
     }
+    FixVirtualSize();
 
     /* For 8bpp, read the 'palettized' setting. Default to enabled. */
     if( wBpp == 8 )
@@ -205,6 +225,44 @@ WORD int_2F_GetVMID( unsigned ax );
     "int    2Fh"                \
     parm [ax] value [bx];
 
+/* Get the CPUID standard feature flags (EDX of function 1), or zero
+ * if the CPU does not support CPUID. Only the EFLAGS.ID bit needs to be
+ * checked because a 386 is the minimum anyway.
+ */
+extern DWORD GetCpuidFeatures( void );
+#pragma aux GetCpuidFeatures =  \
+    ".586"                      \
+    "pushfd"                    \
+    "pop    eax"                \
+    "mov    ecx, eax"           \
+    "xor    eax, 200000h"       \
+    "push   eax"                \
+    "popfd"                     \
+    "pushfd"                    \
+    "pop    eax"                \
+    "push   ecx"                \
+    "popfd"                     \
+    "xor    eax, ecx"           \
+    "jz     NoCPUID"            \
+    "xor    eax, eax"           \
+    "cpuid"                     \
+    "or     eax, eax"           \
+    "jz     NoCPUID"            \
+    "mov    eax, 1"             \
+    "cpuid"                     \
+    "mov    eax, edx"           \
+    "jmp    Done"               \
+    "NoCPUID:"                  \
+    "xor    eax, eax"           \
+    "Done:"                     \
+    "mov    edx, eax"           \
+    "shr    edx, 16"            \
+    value [dx ax] modify [bx cx];
+
+#define CPUID_TSC   0x00000010UL
+#define CPUID_MMX   0x00800000UL
+#define CPUID_SSE   0x02000000UL
+
 /* Dummy pointer to get at the _TEXT segment. Is there any easier way? */
 extern char __based( __segname( "_TEXT" ) ) *pText;
 
@@ -215,6 +273,7 @@ extern char __based( __segname( "_TEXT" ) ) *pText;
 UINT FAR DriverInit( UINT cbHeap, UINT hModule, LPSTR lpCmdLine )
 {
     DEVNODE devNode;
+    DWORD   dwCpuid;
 
     /* Lock the code segment. */
     GlobalSmartPageLock( (__segment)pText );
@@ -227,9 +286,23 @@ UINT FAR DriverInit( UINT cbHeap, UINT hModule, LPSTR lpCmdLine )
 
     dbg_printf( "DriverInit: VDDEntryPoint=%WP, OurVMHandle=%x\n", VDDEntryPoint, OurVMHandle );
 
+    /* See which kernels the CPU can run. MOVNTQ needs SSE (or AMD's
+     * MMX extensions, which we don't bother with).
+     */
+    dwCpuid = GetCpuidFeatures();
+    if( dwCpuid & CPUID_TSC )
+        wCpuFeatures |= CPU_TSC;
+    if( dwCpuid & CPUID_MMX ) {
+        wCpuFeatures |= CPU_MMX;
+        if( dwCpuid & CPUID_SSE )
+            wCpuFeatures |= CPU_SSE;
+    }
+    dbg_printf( "DriverInit: CPUID features %lX, using %s kernels\n", dwCpuid,
+                wCpuFeatures & CPU_SSE ? "MOVNTQ" : wCpuFeatures & CPU_MMX ? "MMX" : "386" );
+
     /* Read the display configuration before doing anything else. */
     LfbBase = 0;
-    devNode = ReadDisplayConfig();
+    devNode = ReadDisplayConfig( 0 );
 
     /* Use the Configuration Manager to locate the base address of the linear framebuffer. */
     if( devNode ) {
@@ -0,0 +1,1291 @@
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;
+; Copyright (c) 2022  Michal Necasek
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+;
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+
+; Framebuffer kernels. Each kernel is written once as a macro and
+; instantiated for every supported color depth (8/16/24/32bpp), so that
+; the inner loops carry no per-pixel color depth checks. The kernels for
+; the current depth are selected in PhysicalEnable (see modes.c).
+;
+; All kernels take their parameters from _KernJob and preserve all
+; registers. Offsets are 32-bit so that all of VRAM can be addressed.
+; Pitches may be negative to process rectangles bottom up. Width and
+; height must not be zero.
+
+; Offsets into the KERNJOB structure, must match minidrv.h.
+KJ_DSTSEL	equ	0
+KJ_SRCSEL	equ	2
+KJ_DSTOFS	equ	4
+KJ_DSTPITCH	equ	8
+KJ_SRCOFS	equ	12
+KJ_SRCPITCH	equ	16
+KJ_WIDTH	equ	20
+KJ_HEIGHT	equ	22
+KJ_COLOR	equ	24
+KJ_BGCOLOR	equ	28
+KJ_SRCBIT	equ	32
+KJ_PATROW	equ	34
+KJ_PATSTEP	equ	36
+KJ_PAT		equ	38
+KJ_ERR		equ	40
+KJ_ERRINC	equ	44
+KJ_ERRDEC	equ	48
+KJ_STYLE	equ	52
+KJ_LINEOP	equ	54
+KJ_AUXSEL	equ	56
+KJ_PATCOL	equ	58
+
+; Bits in KJ_LINEOP, must match minidrv.h.
+LOP_XOR		equ	1
+LOP_OPAQUE	equ	2
+
+_DATA	segment public 'DATA'
+
+; Defined in C code.
+extrn	_KernJob : byte
+extrn	_DitherTab : byte
+extrn	_DitherClamp : byte
+extrn	_SnapLo : dword
+extrn	_SnapHi : dword
+
+_DATA	ends
+
+DGROUP	group	_DATA
+
+;; Convert pixel count in a 32-bit register to bytes.
+PIXTOBYTES	macro	reg, bpp
+if bpp eq 16
+	shl	reg, 1
+elseif bpp eq 24
+	lea	reg, [reg+reg*2]
+elseif bpp eq 32
+	shl	reg, 2
+endif
+	endm
+
+;; Store pixel in ECX at ES:EDI. May destroy ECX.
+PUTPIX	macro	bpp
+if bpp eq 8
+	mov	es:[edi], cl
+elseif bpp eq 16
+	mov	es:[edi], cx
+elseif bpp eq 24
+	mov	es:[edi], cx
+	shr	ecx, 16
+	mov	es:[edi+2], cl
+else
+	mov	es:[edi], ecx
+endif
+	endm
+
+;; XOR pixel in ECX into ES:EDI. May destroy ECX.
+XORPIX	macro	bpp
+if bpp eq 8
+	xor	es:[edi], cl
+elseif bpp eq 16
+	xor	es:[edi], cx
+elseif bpp eq 24
+	xor	es:[edi], cx
+	shr	ecx, 16
+	xor	es:[edi+2], cl
+else
+	xor	es:[edi], ecx
+endif
+	endm
+
+;; Store pixel in ECX at ES:EDI and advance EDI. May destroy ECX.
+STOREPIX	macro	bpp
+	PUTPIX	bpp
+	add	edi, bpp / 8
+	endm
+
+;; Common kernel prologue and epilogue.
+KENTER	macro
+	pushad
+	push	es
+	push	fs
+	cld
+	mov	es, word ptr _KernJob[KJ_DSTSEL]
+	mov	fs, word ptr _KernJob[KJ_SRCSEL]
+	mov	edi, dword ptr _KernJob[KJ_DSTOFS]
+	mov	esi, dword ptr _KernJob[KJ_SRCOFS]
+	mov	bp, word ptr _KernJob[KJ_HEIGHT]
+	endm
+
+KLEAVE	macro
+	pop	fs
+	pop	es
+	popad
+	ret
+	endm
+
+;; Solid fill with KJ_COLOR.
+KERN_FILL	macro	bpp
+	local	row_loop, no_odd
+public	KernFill&bpp&_
+KernFill&bpp&_	proc	near
+	KENTER
+	mov	eax, dword ptr _KernJob[KJ_COLOR]
+	; Replicate the color to fill a dword, if possible.
+if bpp eq 8
+	mov	ah, al
+endif
+if bpp le 16
+	mov	dx, ax
+	shl	eax, 16
+	mov	ax, dx
+endif
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+row_loop:
+	push	edi
+if bpp eq 8
+	mov	ecx, ebx
+	shr	ecx, 2
+	rep	stos dword ptr es:[edi]
+	mov	ecx, ebx
+	and	ecx, 3
+	rep	stos byte ptr es:[edi]
+elseif bpp eq 16
+	mov	ecx, ebx
+	shr	ecx, 1
+	rep	stos dword ptr es:[edi]
+	test	bl, 1
+	jz	no_odd
+	stos	word ptr es:[edi]
+no_odd:
+else
+	mov	ecx, ebx
+	rep	stos dword ptr es:[edi]
+endif
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernFill&bpp&_	endp
+	endm
+
+;; Copy from source to destination, left to right.
+KERN_COPY	macro	bpp
+	local	row_loop
+public	KernCopy&bpp&_
+KernCopy&bpp&_	proc	near
+	KENTER
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+	PIXTOBYTES	ebx, bpp
+row_loop:
+	push	esi
+	push	edi
+	mov	ecx, ebx
+	shr	ecx, 2
+	rep	movs dword ptr es:[edi], dword ptr fs:[esi]
+	mov	ecx, ebx
+	and	ecx, 3
+	rep	movs byte ptr es:[edi], byte ptr fs:[esi]
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernCopy&bpp&_	endp
+	endm
+
+;; Solid fill like KERN_FILL, but with an unrolled loop of MOV instead
+;; of REP STOSD. Which one is faster depends on the host.
+KERN_FILL_UNROLL	macro	bpp
+	local	row_loop, unr_loop, do_rest
+public	KernFillUnr&bpp&_
+KernFillUnr&bpp&_	proc	near
+	KENTER
+	mov	eax, dword ptr _KernJob[KJ_COLOR]
+if bpp eq 8
+	mov	ah, al
+endif
+if bpp le 16
+	mov	dx, ax
+	shl	eax, 16
+	mov	ax, dx
+endif
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+	PIXTOBYTES	ebx, bpp
+row_loop:
+	push	edi
+	mov	ecx, ebx
+	shr	ecx, 4
+	jz	do_rest
+unr_loop:
+	mov	es:[edi], eax
+	mov	es:[edi+4], eax
+	mov	es:[edi+8], eax
+	mov	es:[edi+12], eax
+	add	edi, 16
+	dec	ecx
+	jnz	unr_loop
+do_rest:
+	mov	ecx, ebx
+	and	ecx, 15
+	shr	ecx, 2
+	rep	stos dword ptr es:[edi]
+if bpp eq 8
+	mov	ecx, ebx
+	and	ecx, 3
+	rep	stos byte ptr es:[edi]
+elseif bpp eq 16
+	mov	ecx, ebx
+	and	ecx, 3
+	shr	ecx, 1
+	rep	stos word ptr es:[edi]
+endif
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernFillUnr&bpp&_	endp
+	endm
+
+;; Copy like KERN_COPY, but with an unrolled loop of MOV instead of
+;; REP MOVSD.
+KERN_COPY_UNROLL	macro	bpp
+	local	row_loop, unr_loop, do_rest
+public	KernCopyUnr&bpp&_
+KernCopyUnr&bpp&_	proc	near
+	KENTER
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+	PIXTOBYTES	ebx, bpp
+row_loop:
+	push	esi
+	push	edi
+	mov	edx, ebx
+	shr	edx, 4
+	jz	do_rest
+unr_loop:
+	mov	eax, fs:[esi]
+	mov	ecx, fs:[esi+4]
+	mov	es:[edi], eax
+	mov	es:[edi+4], ecx
+	mov	eax, fs:[esi+8]
+	mov	ecx, fs:[esi+12]
+	mov	es:[edi+8], eax
+	mov	es:[edi+12], ecx
+	add	esi, 16
+	add	edi, 16
+	dec	edx
+	jnz	unr_loop
+do_rest:
+	mov	ecx, ebx
+	and	ecx, 15
+	shr	ecx, 2
+	rep	movs dword ptr es:[edi], dword ptr fs:[esi]
+	mov	ecx, ebx
+	and	ecx, 3
+	rep	movs byte ptr es:[edi], byte ptr fs:[esi]
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernCopyUnr&bpp&_	endp
+	endm
+
+;; Copy from source to destination, right to left. Used when source
+;; and destination overlap on the same scanlines.
+KERN_COPYBACK	macro	bpp
+	local	row_loop
+public	KernCopyBack&bpp&_
+KernCopyBack&bpp&_	proc	near
+	KENTER
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+	PIXTOBYTES	ebx, bpp
+	lea	esi, [esi+ebx-1]
+	lea	edi, [edi+ebx-1]
+	std
+row_loop:
+	push	esi
+	push	edi
+	mov	ecx, ebx
+	and	ecx, 3
+	rep	movs byte ptr es:[edi], byte ptr fs:[esi]
+	sub	esi, 3
+	sub	edi, 3
+	mov	ecx, ebx
+	shr	ecx, 2
+	rep	movs dword ptr es:[edi], dword ptr fs:[esi]
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	cld
+	KLEAVE
+KernCopyBack&bpp&_	endp
+	endm
+
+;; Fill with an 8x8 pattern. KJ_PAT points to eight 64-byte rows in
+;; DGROUP, already rotated such that each row starts at the first
+;; destination pixel. Note that eight pixels take exactly 'bpp' bytes.
+KERN_PAT	macro	bpp
+	local	row_loop, full_loop, do_rest
+public	KernPat&bpp&_
+KernPat&bpp&_	proc	near
+	KENTER
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+	PIXTOBYTES	ebx, bpp
+	mov	dx, word ptr _KernJob[KJ_PATROW]
+row_loop:
+	push	edi
+	mov	eax, ebx
+	; Whole pattern rows (8 pixels) first.
+full_loop:
+	movzx	esi, dx
+	shl	si, 6
+	add	si, word ptr _KernJob[KJ_PAT]
+	cmp	eax, bpp
+	jb	do_rest
+	mov	ecx, bpp / 4
+	rep	movs dword ptr es:[edi], dword ptr ds:[esi]
+	sub	eax, bpp
+	jmp	full_loop
+do_rest:
+	mov	ecx, eax
+	rep	movs byte ptr es:[edi], byte ptr ds:[esi]
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	; Next pattern row.
+	add	dx, word ptr _KernJob[KJ_PATSTEP]
+	and	dx, 7
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernPat&bpp&_	endp
+	endm
+
+;; XOR with KJ_COLOR. With all bits set, this inverts the destination.
+KERN_XOR	macro	bpp
+	local	row_loop, x_loop, do_tail, t_loop, next_row
+public	KernXor&bpp&_
+KernXor&bpp&_	proc	near
+	KENTER
+	mov	eax, dword ptr _KernJob[KJ_COLOR]
+if bpp eq 8
+	mov	ah, al
+endif
+if bpp le 16
+	mov	dx, ax
+	shl	eax, 16
+	mov	ax, dx
+endif
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+	PIXTOBYTES	ebx, bpp
+row_loop:
+	push	edi
+	mov	ecx, ebx
+	shr	ecx, 2
+	jz	do_tail
+x_loop:
+	xor	es:[edi], eax
+	add	edi, 4
+	dec	ecx
+	jnz	x_loop
+do_tail:
+if bpp eq 8
+	mov	ecx, ebx
+	and	ecx, 3
+	jz	next_row
+t_loop:
+	xor	es:[edi], al
+	inc	edi
+	dec	ecx
+	jnz	t_loop
+endif
+if bpp eq 16
+	test	bl, 2
+	jz	next_row
+	xor	es:[edi], ax
+endif
+next_row:
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernXor&bpp&_	endp
+	endm
+
+;; Transparent hatch fill. Draw KJ_COLOR where the mask bit is set and
+;; leave the other pixels alone. KJ_PAT points to eight mask bytes, one
+;; per pattern row, rotated such that the MSB is the first pixel.
+KERN_HATCH	macro	bpp
+	local	row_loop, pix_loop, skip_pix
+public	KernHatch&bpp&_
+KernHatch&bpp&_	proc	near
+	KENTER
+	mov	ebx, dword ptr _KernJob[KJ_COLOR]
+	mov	dx, word ptr _KernJob[KJ_PATROW]
+row_loop:
+	push	edi
+	mov	si, dx
+	add	si, word ptr _KernJob[KJ_PAT]
+	mov	al, [si]
+	movzx	esi, word ptr _KernJob[KJ_WIDTH]
+pix_loop:
+	rol	al, 1
+	jnc	skip_pix
+	mov	ecx, ebx
+	PUTPIX	bpp
+skip_pix:
+	add	edi, bpp / 8
+	dec	esi
+	jnz	pix_loop
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	dx, word ptr _KernJob[KJ_PATSTEP]
+	and	dx, 7
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernHatch&bpp&_	endp
+	endm
+
+;; Expand a monochrome source through the table at KJ_PAT, which holds
+;; the 8 destination pixels for each source byte in 32-byte entries (see
+;; mono.c). KJ_SRCBIT is the bit number of the first pixel within the
+;; first source byte, counting from the MSB. Whole source bytes are
+;; copied from the table a dword at a time.
+KERN_MONO	macro	bpp
+	local	row_loop, byte_loop, partial, n_ok, row_done
+public	KernMono&bpp&_
+KernMono&bpp&_	proc	near
+	KENTER
+	mov	ebx, esi
+row_loop:
+	push	ebx
+	push	edi
+	movzx	edx, word ptr _KernJob[KJ_WIDTH]
+	movzx	eax, word ptr _KernJob[KJ_SRCBIT]
+byte_loop:
+	movzx	esi, byte ptr fs:[ebx]
+	inc	ebx
+	shl	esi, 5
+	movzx	ecx, word ptr _KernJob[KJ_PAT]
+	add	esi, ecx
+	or	eax, eax
+	jnz	partial
+	cmp	edx, 8
+	jb	partial
+	mov	ecx, bpp / 4
+	rep	movs dword ptr es:[edi], dword ptr ds:[esi]
+	sub	edx, 8
+	jnz	byte_loop
+	jmp	row_done
+partial:
+	; Copy pixels EAX to EAX+ECX-1 of the entry.
+	mov	ecx, 8
+	sub	ecx, eax
+	cmp	ecx, edx
+	jbe	n_ok
+	mov	ecx, edx
+n_ok:
+	sub	edx, ecx
+	PIXTOBYTES	eax, bpp
+	add	esi, eax
+	PIXTOBYTES	ecx, bpp
+	rep	movs byte ptr es:[edi], byte ptr ds:[esi]
+	xor	eax, eax
+	or	edx, edx
+	jnz	byte_loop
+row_done:
+	pop	edi
+	pop	ebx
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	ebx, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernMono&bpp&_	endp
+	endm
+
+;; Transparent monochrome expansion: set source bits are drawn in
+;; KJ_COLOR, clear bits leave the destination alone. Whole bytes with
+;; all bits clear are skipped, with all bits set copied from entry 0FFh
+;; of the table at KJ_PAT.
+KERN_MONOTR	macro	bpp
+	local	row_loop, byte_loop, not_zero, partial, n_ok, pix_loop, skip_pix, row_done
+public	KernMonoTr&bpp&_
+KernMonoTr&bpp&_	proc	near
+	KENTER
+	mov	ebx, esi
+row_loop:
+	push	ebx
+	push	edi
+	movzx	edx, word ptr _KernJob[KJ_WIDTH]
+	mov	cl, byte ptr _KernJob[KJ_SRCBIT]
+byte_loop:
+	mov	al, fs:[ebx]
+	inc	ebx
+	or	cl, cl
+	jnz	partial
+	cmp	edx, 8
+	jb	partial
+	or	al, al
+	jnz	not_zero
+	add	edi, bpp
+	sub	edx, 8
+	jnz	byte_loop
+	jmp	row_done
+not_zero:
+	cmp	al, 0FFh
+	jne	partial
+	movzx	esi, word ptr _KernJob[KJ_PAT]
+	add	esi, 0FFh * 32
+	mov	ecx, bpp / 4
+	rep	movs dword ptr es:[edi], dword ptr ds:[esi]
+	sub	edx, 8
+	jnz	byte_loop
+	jmp	row_done
+partial:
+	; Do 8 - CL pixels (or fewer, at the end) one at a time.
+	shl	al, cl
+	movzx	esi, cl
+	mov	ecx, 8
+	sub	ecx, esi
+	cmp	ecx, edx
+	jbe	n_ok
+	mov	ecx, edx
+n_ok:
+	sub	edx, ecx
+	mov	ah, cl
+pix_loop:
+	shl	al, 1
+	jnc	skip_pix
+	mov	ecx, dword ptr _KernJob[KJ_COLOR]
+	PUTPIX	bpp
+skip_pix:
+	add	edi, bpp / 8
+	dec	ah
+	jnz	pix_loop
+	xor	ecx, ecx
+	or	edx, edx
+	jnz	byte_loop
+row_done:
+	pop	edi
+	pop	ebx
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	ebx, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernMonoTr&bpp&_	endp
+	endm
+
+;; Convert a 24bpp (B, G, R byte order) source to the destination format.
+;; Not needed at 24bpp (a plain copy) and not possible at 8bpp.
+KERN_CONV24	macro	bpp
+	local	row_loop, pix_loop
+public	KernConv24to&bpp&_
+KernConv24to&bpp&_	proc	near
+	KENTER
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+row_loop:
+	push	esi
+	push	edi
+	mov	edx, ebx
+pix_loop:
+if bpp eq 16
+	; Pack into 5-6-5 format.
+	movzx	cx, byte ptr fs:[esi+2]
+	shr	cx, 3
+	shl	cx, 6
+	mov	al, fs:[esi+1]
+	shr	al, 2
+	or	cl, al
+	shl	cx, 5
+	mov	al, fs:[esi]
+	shr	al, 3
+	or	cl, al
+else
+	; Don't read beyond the last source pixel.
+	movzx	ecx, byte ptr fs:[esi+2]
+	shl	ecx, 16
+	mov	cx, fs:[esi]
+endif
+	add	esi, 3
+	STOREPIX	bpp
+	dec	edx
+	jnz	pix_loop
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernConv24to&bpp&_	endp
+	endm
+
+_TEXT	segment	public 'CODE'
+
+.386
+assume	ds:DGROUP, es:nothing
+
+;; Instantiate the kernels for each color depth. Fill, copy, pattern, and
+;; XOR kernels for 24bpp are separate, see below.
+irp	bpp, <8, 16, 32>
+	KERN_FILL	bpp
+	KERN_COPY	bpp
+	KERN_PAT	bpp
+	KERN_XOR	bpp
+	endm
+
+;; XOR with the 8x8 pattern at KJ_PAT, like KERN_PAT. A pattern row is
+;; always a whole number of dwords (bpp bytes), so it is XORed a dword at
+;; a time and only the end of a scanline is done by bytes.
+KERN_PATXOR	macro	bpp
+	local	row_loop, full_loop, dw_loop, do_rest, b_loop, next_row
+public	KernPatXor&bpp&_
+KernPatXor&bpp&_	proc	near
+	KENTER
+	mov	dx, word ptr _KernJob[KJ_PATROW]
+row_loop:
+	push	edi
+	movzx	eax, word ptr _KernJob[KJ_WIDTH]
+	PIXTOBYTES	eax, bpp
+full_loop:
+	movzx	esi, dx
+	shl	si, 6
+	add	si, word ptr _KernJob[KJ_PAT]
+	cmp	eax, bpp
+	jb	do_rest
+	mov	ecx, bpp / 4
+dw_loop:
+	mov	ebx, [esi]
+	xor	es:[edi], ebx
+	add	esi, 4
+	add	edi, 4
+	dec	ecx
+	jnz	dw_loop
+	sub	eax, bpp
+	jmp	full_loop
+do_rest:
+	mov	ecx, eax
+	jecxz	next_row
+b_loop:
+	mov	bl, [esi]
+	xor	es:[edi], bl
+	inc	esi
+	inc	edi
+	dec	ecx
+	jnz	b_loop
+next_row:
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	; Next pattern row.
+	add	dx, word ptr _KernJob[KJ_PATSTEP]
+	and	dx, 7
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernPatXor&bpp&_	endp
+	endm
+
+;; Bresenham line of KJ_WIDTH pixels. KJ_DSTPITCH is the byte step
+;; along the major axis, KJ_SRCPITCH the step along the minor axis. The
+;; minor step is taken whenever the error term, incremented by KJ_ERRINC
+;; for each pixel, reaches KJ_ERRDEC. Horizontal and vertical lines have
+;; a zero KJ_ERRINC. KJ_STYLE is rotated left for each pixel; clear bits
+;; are gaps, which are skipped or drawn with KJ_BGCOLOR if LOP_OPAQUE is
+;; set. With LOP_XOR, the colors are XORed into the destination.
+KERN_LINE	macro	bpp
+	local	pix_loop, gap, draw, do_xor, step, no_minor
+public	KernLine&bpp&_
+KernLine&bpp&_	proc	near
+	KENTER
+	mov	bp, word ptr _KernJob[KJ_WIDTH]
+	mov	esi, dword ptr _KernJob[KJ_ERR]
+	mov	dx, word ptr _KernJob[KJ_STYLE]
+	mov	bl, byte ptr _KernJob[KJ_LINEOP]
+pix_loop:
+	rol	dx, 1
+	jnc	gap
+	mov	ecx, dword ptr _KernJob[KJ_COLOR]
+	jmp	draw
+gap:
+	test	bl, LOP_OPAQUE
+	jz	step
+	mov	ecx, dword ptr _KernJob[KJ_BGCOLOR]
+draw:
+	test	bl, LOP_XOR
+	jnz	do_xor
+	PUTPIX	bpp
+	jmp	step
+do_xor:
+	XORPIX	bpp
+step:
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_ERRINC]
+	cmp	esi, dword ptr _KernJob[KJ_ERRDEC]
+	jl	no_minor
+	sub	esi, dword ptr _KernJob[KJ_ERRDEC]
+	add	edi, dword ptr _KernJob[KJ_SRCPITCH]
+no_minor:
+	dec	bp
+	jnz	pix_loop
+	KLEAVE
+KernLine&bpp&_	endp
+	endm
+
+irp	bpp, <8, 16, 24, 32>
+	KERN_COPYBACK	bpp
+	KERN_MONO	bpp
+	KERN_MONOTR	bpp
+	KERN_COPY_UNROLL	bpp
+	KERN_HATCH	bpp
+	KERN_LINE	bpp
+	KERN_PATXOR	bpp
+	endm
+
+irp	bpp, <8, 16, 32>
+	KERN_FILL_UNROLL	bpp
+	endm
+
+irp	bpp, <16, 32>
+	KERN_CONV24	bpp
+	endm
+
+;; Map a 24bpp or 32bpp (B, G, R byte order) source to 8bpp palette
+;; indexes through the 32K-entry 5-5-5 inverse colormap at KJ_AUXSEL:0.
+KERN_MAP8	macro	srcbpp
+	local	row_loop, pix_loop
+public	KernMap&srcbpp&to8_
+KernMap&srcbpp&to8_	proc	near
+	KENTER
+	push	gs
+	mov	gs, word ptr _KernJob[KJ_AUXSEL]
+row_loop:
+	push	esi
+	push	edi
+	mov	dx, word ptr _KernJob[KJ_WIDTH]
+pix_loop:
+	movzx	ebx, byte ptr fs:[esi+2]
+	shr	ebx, 3
+	shl	ebx, 5
+	movzx	eax, byte ptr fs:[esi+1]
+	shr	eax, 3
+	or	ebx, eax
+	shl	ebx, 5
+	movzx	eax, byte ptr fs:[esi]
+	shr	eax, 3
+	or	ebx, eax
+	mov	al, gs:[ebx]
+	mov	es:[edi], al
+	inc	edi
+	add	esi, srcbpp / 8
+	dec	dx
+	jnz	pix_loop
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	pop	gs
+	KLEAVE
+KernMap&srcbpp&to8_	endp
+	endm
+
+irp	srcbpp, <24, 32>
+	KERN_MAP8	srcbpp
+	endm
+
+;; Ordered dither of 24bpp or 32bpp pixels to 8bpp. Each component is
+;; offset by the threshold for the pixel's position in the 8x8 dither
+;; matrix and clamped to 5 bits, then the 5-5-5 value is mapped through
+;; the inverse colormap at GS:0. CX holds the matrix index (row * 8 +
+;; column) and BP accumulates the map index, so the row count is kept in
+;; KJ_HEIGHT.
+DITH5	macro	ofs
+	movzx	bx, byte ptr fs:[esi+ofs]
+	add	bx, ax
+	movzx	bx, byte ptr _DitherClamp[bx]
+	endm
+
+KERN_DITH8	macro	srcbpp
+	local	row_loop, pix_loop, same_row
+public	KernDither&srcbpp&to8_
+KernDither&srcbpp&to8_	proc	near
+	KENTER
+	push	gs
+	mov	gs, word ptr _KernJob[KJ_AUXSEL]
+row_loop:
+	push	esi
+	push	edi
+	mov	cx, word ptr _KernJob[KJ_PATROW]
+	shl	cx, 3
+	or	cx, word ptr _KernJob[KJ_PATCOL]
+	mov	dx, word ptr _KernJob[KJ_WIDTH]
+pix_loop:
+	mov	bx, cx
+	movzx	ax, byte ptr _DitherTab[bx]
+	DITH5	2
+	mov	bp, bx
+	shl	bp, 5
+	DITH5	1
+	or	bp, bx
+	shl	bp, 5
+	DITH5	0
+	or	bx, bp
+	mov	al, gs:[bx]
+	mov	es:[edi], al
+	inc	edi
+	add	esi, srcbpp / 8
+	inc	cx
+	test	cl, 7
+	jnz	same_row
+	sub	cx, 8
+same_row:
+	dec	dx
+	jnz	pix_loop
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	mov	ax, word ptr _KernJob[KJ_PATROW]
+	inc	ax
+	and	ax, 7
+	mov	word ptr _KernJob[KJ_PATROW], ax
+	dec	word ptr _KernJob[KJ_HEIGHT]
+	jnz	row_loop
+	pop	gs
+	KLEAVE
+KernDither&srcbpp&to8_	endp
+	endm
+
+irp	srcbpp, <24, 32>
+	KERN_DITH8	srcbpp
+	endm
+
+;; Translate 8bpp pixels in place through the 256-byte table at FS:ESI.
+;; Aligned dwords are read once, translated a byte at a time, and only
+;; written back if any of the four pixels changed.
+XLAT8	macro
+	movzx	ecx, al
+	mov	al, fs:[esi+ecx]
+	endm
+
+public	KernXlat8_
+KernXlat8_	proc	near
+	KENTER
+x8_row_loop:
+	push	edi
+	mov	dx, word ptr _KernJob[KJ_WIDTH]
+x8_lead_loop:
+	test	edi, 3
+	jz	x8_dw_start
+	mov	al, es:[edi]
+	XLAT8
+	mov	es:[edi], al
+	inc	edi
+	dec	dx
+	jnz	x8_lead_loop
+	jmp	x8_next_row
+x8_dw_start:
+	mov	bx, dx
+	shr	bx, 2
+	jz	x8_tail_start
+x8_dw_loop:
+	mov	eax, es:[edi]
+	push	eax
+	XLAT8
+	ror	eax, 8
+	XLAT8
+	ror	eax, 8
+	XLAT8
+	ror	eax, 8
+	XLAT8
+	ror	eax, 8
+	pop	ecx
+	cmp	eax, ecx
+	je	x8_dw_same
+	mov	es:[edi], eax
+x8_dw_same:
+	add	edi, 4
+	dec	bx
+	jnz	x8_dw_loop
+x8_tail_start:
+	and	dx, 3
+	jz	x8_next_row
+x8_tail_loop:
+	mov	al, es:[edi]
+	XLAT8
+	mov	es:[edi], al
+	inc	edi
+	dec	dx
+	jnz	x8_tail_loop
+x8_next_row:
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	dec	bp
+	jnz	x8_row_loop
+	KLEAVE
+KernXlat8_	endp
+
+;; Convert srcbpp pixels to 24bpp or 32bpp RGB. 8bpp and 16bpp pixels
+;; are looked up in _SnapLo (low byte) and _SnapHi (high byte).
+KERN_SNAP	macro	srcbpp, dstbpp
+	local	row_loop, pix_loop
+public	KernSnap&srcbpp&to&dstbpp&_
+KernSnap&srcbpp&to&dstbpp&_	proc	near
+	KENTER
+row_loop:
+	push	esi
+	push	edi
+	mov	dx, word ptr _KernJob[KJ_WIDTH]
+pix_loop:
+if srcbpp eq 8
+	movzx	ebx, byte ptr fs:[esi]
+	mov	ecx, _SnapLo[ebx*4]
+elseif srcbpp eq 16
+	movzx	ebx, byte ptr fs:[esi]
+	mov	ecx, _SnapLo[ebx*4]
+	movzx	ebx, byte ptr fs:[esi+1]
+	or	ecx, _SnapHi[ebx*4]
+elseif srcbpp eq 24
+	movzx	ecx, byte ptr fs:[esi+2]
+	shl	ecx, 16
+	mov	cx, fs:[esi]
+else
+	mov	ecx, fs:[esi]
+	and	ecx, 0FFFFFFh
+endif
+	add	esi, srcbpp / 8
+	STOREPIX	dstbpp
+	dec	dx
+	jnz	pix_loop
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernSnap&srcbpp&to&dstbpp&_	endp
+	endm
+
+irp	srcbpp, <8, 16, 24, 32>
+	KERN_SNAP	srcbpp, 24
+	KERN_SNAP	srcbpp, 32
+	endm
+
+;; Copy with every pixel doubled in both directions. Each source row is
+;; written to two destination rows, KJ_DSTPITCH apart.
+KERN_DOUBLE	macro	bpp
+	local	row_loop, pix_loop
+public	KernDouble&bpp&_
+KernDouble&bpp&_	proc	near
+	KENTER
+	mov	edx, dword ptr _KernJob[KJ_DSTPITCH]
+row_loop:
+	push	esi
+	push	edi
+	mov	bx, word ptr _KernJob[KJ_WIDTH]
+pix_loop:
+if bpp eq 8
+	mov	al, fs:[esi]
+	mov	ah, al
+	mov	es:[edi], ax
+	mov	es:[edi+edx], ax
+elseif bpp eq 16
+	mov	ax, fs:[esi]
+	mov	cx, ax
+	shl	eax, 16
+	mov	ax, cx
+	mov	es:[edi], eax
+	mov	es:[edi+edx], eax
+elseif bpp eq 24
+	mov	ax, fs:[esi]
+	mov	cl, fs:[esi+2]
+	mov	es:[edi], ax
+	mov	es:[edi+2], cl
+	mov	es:[edi+3], ax
+	mov	es:[edi+5], cl
+	mov	es:[edi+edx], ax
+	mov	es:[edi+edx+2], cl
+	mov	es:[edi+edx+3], ax
+	mov	es:[edi+edx+5], cl
+else
+	mov	eax, fs:[esi]
+	mov	es:[edi], eax
+	mov	es:[edi+4], eax
+	mov	es:[edi+edx], eax
+	mov	es:[edi+edx+4], eax
+endif
+	add	esi, bpp / 8
+	add	edi, bpp / 4
+	dec	bx
+	jnz	pix_loop
+	pop	edi
+	pop	esi
+	lea	edi, [edi+edx*2]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	KLEAVE
+KernDouble&bpp&_	endp
+	endm
+
+irp	bpp, <8, 16, 24, 32>
+	KERN_DOUBLE	bpp
+	endm
+
+;; Packed 24bpp kernels. Four pixels take exactly three dwords. Leading
+;; pixels are processed one at a time until the destination is dword
+;; aligned (which happens after 'offset & 3' pixels), then groups of four
+;; pixels are written as three aligned dwords, and finally any remaining
+;; pixels are done one at a time again.
+
+;; Store the 24-bit pixel in the low three bytes of EBX at ES:EDI.
+PUT24	macro
+	mov	es:[edi], bx
+	ror	ebx, 16
+	mov	es:[edi+2], bl
+	rol	ebx, 16
+	add	edi, 3
+	endm
+
+;; XOR the 24-bit pixel in the low three bytes of EBX into ES:EDI.
+XOR24	macro
+	xor	es:[edi], bx
+	ror	ebx, 16
+	xor	es:[edi+2], bl
+	rol	ebx, 16
+	add	edi, 3
+	endm
+
+;; Get the number of leading pixels into ECX, at most EAX. Subtract
+;; it from EAX.
+LEAD24	macro
+	local	lead_ok
+	mov	ecx, edi
+	and	ecx, 3
+	cmp	ecx, eax
+	jbe	lead_ok
+	mov	ecx, eax
+lead_ok:
+	sub	eax, ecx
+	endm
+
+;; Solid fill. The three dwords (B G R B, G R B G, R B G R) are
+;; precomputed in EBX, EDX, and EAX, respectively.
+public	KernFill24_
+KernFill24_	proc	near
+	KENTER
+	mov	eax, dword ptr _KernJob[KJ_COLOR]
+	and	eax, 0FFFFFFh
+	mov	ebx, eax
+	shl	ebx, 24
+	or	ebx, eax
+	mov	ecx, eax
+	shr	ecx, 8
+	mov	edx, eax
+	shl	edx, 16
+	or	edx, ecx
+	mov	ecx, eax
+	shr	ecx, 16
+	shl	eax, 8
+	or	eax, ecx
+f24_row:
+	push	edi
+	movzx	esi, word ptr _KernJob[KJ_WIDTH]
+	mov	ecx, edi
+	and	ecx, 3
+	jz	f24_aligned
+f24_lead:
+	PUT24
+	dec	esi
+	jz	f24_next
+	dec	ecx
+	jnz	f24_lead
+f24_aligned:
+	mov	ecx, esi
+	shr	ecx, 2
+	jz	f24_tail
+f24_group:
+	mov	es:[edi], ebx
+	mov	es:[edi+4], edx
+	mov	es:[edi+8], eax
+	add	edi, 12
+	dec	ecx
+	jnz	f24_group
+f24_tail:
+	and	esi, 3
+	jz	f24_next
+f24_trail:
+	PUT24
+	dec	esi
+	jnz	f24_trail
+f24_next:
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	dec	bp
+	jnz	f24_row
+	KLEAVE
+KernFill24_	endp
+
+;; Copy from source to destination, left to right. The destination
+;; is aligned, the source may not be.
+public	KernCopy24_
+KernCopy24_	proc	near
+	KENTER
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+c24_row:
+	push	esi
+	push	edi
+	mov	eax, ebx
+	LEAD24
+	lea	ecx, [ecx+ecx*2]
+	rep	movs byte ptr es:[edi], byte ptr fs:[esi]
+	mov	ecx, eax
+	shr	ecx, 2
+	lea	ecx, [ecx+ecx*2]
+	rep	movs dword ptr es:[edi], dword ptr fs:[esi]
+	mov	ecx, eax
+	and	ecx, 3
+	lea	ecx, [ecx+ecx*2]
+	rep	movs byte ptr es:[edi], byte ptr fs:[esi]
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	c24_row
+	KLEAVE
+KernCopy24_	endp
+
+;; Fill with an 8x8 pattern. Each 64-byte pattern row holds the 24-byte
+;; pattern twice, so that three dwords can be read at any pixel within
+;; the first period. EBX points to the start of the pattern row.
+public	KernPat24_
+KernPat24_	proc	near
+	KENTER
+	mov	dx, word ptr _KernJob[KJ_PATROW]
+p24_row:
+	push	edi
+	movzx	ebx, dx
+	shl	bx, 6
+	add	bx, word ptr _KernJob[KJ_PAT]
+	mov	esi, ebx
+	movzx	eax, word ptr _KernJob[KJ_WIDTH]
+	LEAD24
+	lea	ecx, [ecx+ecx*2]
+	rep	movs byte ptr es:[edi], byte ptr ds:[esi]
+p24_group:
+	cmp	eax, 4
+	jb	p24_tail
+	mov	ecx, 3
+	rep	movs dword ptr es:[edi], dword ptr ds:[esi]
+	; Wrap around to the first period.
+	lea	ecx, [ebx+24]
+	cmp	esi, ecx
+	jb	p24_nowrap
+	sub	esi, 24
+p24_nowrap:
+	sub	eax, 4
+	jmp	p24_group
+p24_tail:
+	lea	ecx, [eax+eax*2]
+	rep	movs byte ptr es:[edi], byte ptr ds:[esi]
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	; Next pattern row.
+	add	dx, word ptr _KernJob[KJ_PATSTEP]
+	and	dx, 7
+	dec	bp
+	jnz	p24_row
+	KLEAVE
+KernPat24_	endp
+
+;; XOR with KJ_COLOR, see KernFill24.
+public	KernXor24_
+KernXor24_	proc	near
+	KENTER
+	mov	eax, dword ptr _KernJob[KJ_COLOR]
+	and	eax, 0FFFFFFh
+	mov	ebx, eax
+	shl	ebx, 24
+	or	ebx, eax
+	mov	ecx, eax
+	shr	ecx, 8
+	mov	edx, eax
+	shl	edx, 16
+	or	edx, ecx
+	mov	ecx, eax
+	shr	ecx, 16
+	shl	eax, 8
+	or	eax, ecx
+x24_row:
+	push	edi
+	movzx	esi, word ptr _KernJob[KJ_WIDTH]
+	mov	ecx, edi
+	and	ecx, 3
+	jz	x24_aligned
+x24_lead:
+	XOR24
+	dec	esi
+	jz	x24_next
+	dec	ecx
+	jnz	x24_lead
+x24_aligned:
+	mov	ecx, esi
+	shr	ecx, 2
+	jz	x24_tail
+x24_group:
+	xor	es:[edi], ebx
+	xor	es:[edi+4], edx
+	xor	es:[edi+8], eax
+	add	edi, 12
+	dec	ecx
+	jnz	x24_group
+x24_tail:
+	and	esi, 3
+	jz	x24_next
+x24_trail:
+	XOR24
+	dec	esi
+	jnz	x24_trail
+x24_next:
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	dec	bp
+	jnz	x24_row
+	KLEAVE
+KernXor24_	endp
+
+_TEXT	ends
+
+end
@@ -0,0 +1,318 @@
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;
+; Copyright (c) 2022  Michal Necasek
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+;
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+
+; MMX versions of the framebuffer kernels in kernels.asm. Each kernel
+; exists in two flavors, one using plain MOVQ stores and one using
+; non-temporal MOVNTQ stores (requires SSE). They are only selected in
+; PhysicalEnable (see modes.c) if the CPU supports them.
+;
+; The kernels run in the context of whatever task called GDI, so the FPU
+; state (which MMX shares) is saved on entry and restored on exit. That
+; is not worth doing for narrow rectangles, which are passed on to the
+; regular kernels. The state is saved on the stack, because interrupt-time
+; cursor and shadow flush code can run a kernel while another one is busy.
+
+; Offsets into the KERNJOB structure, must match minidrv.h.
+KJ_DSTSEL	equ	0
+KJ_SRCSEL	equ	2
+KJ_DSTOFS	equ	4
+KJ_DSTPITCH	equ	8
+KJ_SRCOFS	equ	12
+KJ_SRCPITCH	equ	16
+KJ_WIDTH	equ	20
+KJ_HEIGHT	equ	22
+KJ_COLOR	equ	24
+
+; Minimum width in bytes for the MMX kernels.
+MMX_MIN_BYTES	equ	64
+
+; Size of the FPU state saved by FSAVE (32-bit format, the larger one).
+FPU_STATE	equ	108
+
+_DATA	segment public 'DATA'
+
+; Defined in C code.
+extrn	_KernJob : byte
+
+_DATA	ends
+
+DGROUP	group	_DATA
+
+;; Convert pixel count in a 32-bit register to bytes.
+PIXTOBYTES	macro	reg, bpp
+if bpp eq 16
+	shl	reg, 1
+elseif bpp eq 24
+	lea	reg, [reg+reg*2]
+elseif bpp eq 32
+	shl	reg, 2
+endif
+	endm
+
+;; Store ECX pixels from EAX with REP STOS.
+STOSPIX	macro	bpp
+if bpp eq 8
+	rep	stos byte ptr es:[edi]
+elseif bpp eq 16
+	shr	ecx, 1
+	rep	stos word ptr es:[edi]
+else
+	shr	ecx, 2
+	rep	stos dword ptr es:[edi]
+endif
+	endm
+
+;; Common kernel prologue and epilogue, as in kernels.asm.
+KENTER	macro
+	pushad
+	push	es
+	push	fs
+	cld
+	mov	es, word ptr _KernJob[KJ_DSTSEL]
+	mov	fs, word ptr _KernJob[KJ_SRCSEL]
+	mov	edi, dword ptr _KernJob[KJ_DSTOFS]
+	mov	esi, dword ptr _KernJob[KJ_SRCOFS]
+	mov	bp, word ptr _KernJob[KJ_HEIGHT]
+	endm
+
+KLEAVE	macro
+	pop	fs
+	pop	es
+	popad
+	ret
+	endm
+
+;; Save the FPU state (this also initializes the FPU) on the stack before
+;; using MMX, and restore it afterwards. Pushes and pops in between must
+;; balance. SFENCE orders the non-temporal stores.
+MMXENTER	macro
+	sub	sp, FPU_STATE
+	push	bx
+	mov	bx, sp
+	fsave	ss:[bx+2]
+	pop	bx
+	endm
+
+MMXLEAVE	macro	sfx
+ifidn <sfx>, <NT>
+	sfence
+endif
+	emms
+	push	bx
+	mov	bx, sp
+	frstor	ss:[bx+2]
+	pop	bx
+	add	sp, FPU_STATE
+	endm
+
+;; Solid fill with KJ_COLOR. The leading and trailing pixels which
+;; don't fill a whole aligned qword are stored with REP STOS.
+KERN_FILL_MMX	macro	bpp, sfx, store
+	local	row_loop, q_loop
+public	KernFill&sfx&&bpp&_
+KernFill&sfx&&bpp&_	proc	near
+	cmp	word ptr _KernJob[KJ_WIDTH], MMX_MIN_BYTES * 8 / bpp
+	jb	KernFill&bpp&_
+	KENTER
+	MMXENTER
+	mov	eax, dword ptr _KernJob[KJ_COLOR]
+if bpp eq 8
+	mov	ah, al
+endif
+if bpp le 16
+	mov	dx, ax
+	shl	eax, 16
+	mov	ax, dx
+endif
+	movd	mm0, eax
+	punpckldq	mm0, mm0
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+	PIXTOBYTES	ebx, bpp
+row_loop:
+	push	edi
+	mov	edx, ebx
+	mov	ecx, edi
+	neg	ecx
+	and	ecx, 7
+	sub	edx, ecx
+	STOSPIX	bpp
+	mov	ecx, edx
+	shr	ecx, 3
+q_loop:
+	store	es:[edi], mm0
+	add	edi, 8
+	dec	ecx
+	jnz	q_loop
+	mov	ecx, edx
+	and	ecx, 7
+	STOSPIX	bpp
+	pop	edi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	dec	bp
+	jnz	row_loop
+	MMXLEAVE	sfx
+	KLEAVE
+KernFill&sfx&&bpp&_	endp
+	endm
+
+;; Copy from source to destination, left to right. The destination
+;; is qword aligned, the source may not be.
+KERN_COPY_MMX	macro	bpp, sfx, store
+	local	row_loop, q_loop
+public	KernCopy&sfx&&bpp&_
+KernCopy&sfx&&bpp&_	proc	near
+	cmp	word ptr _KernJob[KJ_WIDTH], MMX_MIN_BYTES * 8 / bpp
+	jb	KernCopy&bpp&_
+	KENTER
+	MMXENTER
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+	PIXTOBYTES	ebx, bpp
+row_loop:
+	push	esi
+	push	edi
+	mov	edx, ebx
+	mov	ecx, edi
+	neg	ecx
+	and	ecx, 7
+	sub	edx, ecx
+	rep	movs byte ptr es:[edi], byte ptr fs:[esi]
+	mov	ecx, edx
+	shr	ecx, 3
+q_loop:
+	movq	mm0, fs:[esi]
+	store	es:[edi], mm0
+	add	esi, 8
+	add	edi, 8
+	dec	ecx
+	jnz	q_loop
+	mov	ecx, edx
+	and	ecx, 7
+	rep	movs byte ptr es:[edi], byte ptr fs:[esi]
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	MMXLEAVE	sfx
+	KLEAVE
+KernCopy&sfx&&bpp&_	endp
+	endm
+
+;; Convert a 24bpp source to 32bpp, two pixels at a time. The pixels are
+;; loaded as dwords and the extra byte is masked off. The last pixel of
+;; a scanline is always converted separately so that nothing is read
+;; past the end of the source.
+KERN_CONV24_MMX	macro	sfx, store
+	local	row_loop, pair_loop, one_pix, one_loop
+public	KernConv24to32&sfx&_
+KernConv24to32&sfx&_	proc	near
+	cmp	word ptr _KernJob[KJ_WIDTH], MMX_MIN_BYTES / 4
+	jb	KernConv24to32_
+	KENTER
+	MMXENTER
+	mov	eax, 0FFFFFFh
+	movd	mm7, eax
+	punpckldq	mm7, mm7
+	movzx	ebx, word ptr _KernJob[KJ_WIDTH]
+row_loop:
+	push	esi
+	push	edi
+	mov	edx, ebx
+	; Align the destination to a qword.
+	test	di, 4
+	jz	pair_loop
+	call	one_pix
+pair_loop:
+	movd	mm0, fs:[esi]
+	movd	mm1, fs:[esi+3]
+	punpckldq	mm0, mm1
+	pand	mm0, mm7
+	store	es:[edi], mm0
+	add	esi, 6
+	add	edi, 8
+	sub	edx, 2
+	cmp	edx, 3
+	jae	pair_loop
+one_loop:
+	call	one_pix
+	or	edx, edx
+	jnz	one_loop
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _KernJob[KJ_DSTPITCH]
+	add	esi, dword ptr _KernJob[KJ_SRCPITCH]
+	dec	bp
+	jnz	row_loop
+	MMXLEAVE	sfx
+	KLEAVE
+
+; Convert a single pixel.
+one_pix:
+	movzx	ecx, byte ptr fs:[esi+2]
+	shl	ecx, 16
+	mov	cx, fs:[esi]
+	mov	es:[edi], ecx
+	add	esi, 3
+	add	edi, 4
+	dec	edx
+	retn
+KernConv24to32&sfx&_	endp
+	endm
+
+_TEXT	segment	public 'CODE'
+
+.686
+.mmx
+.xmm
+assume	ds:DGROUP, es:nothing
+
+; Regular kernels in kernels.asm.
+irp	bpp, <8, 16, 24, 32>
+extrn	KernCopy&bpp&_ : near
+	endm
+irp	bpp, <8, 16, 32>
+extrn	KernFill&bpp&_ : near
+	endm
+extrn	KernConv24to32_ : near
+
+;; Instantiate the kernels. There is no MMX fill at 24bpp; the packed
+;; 386 fill already writes aligned dwords.
+irp	bpp, <8, 16, 32>
+	KERN_FILL_MMX	bpp, MMX, movq
+	KERN_FILL_MMX	bpp, NT, movntq
+	endm
+
+irp	bpp, <8, 16, 24, 32>
+	KERN_COPY_MMX	bpp, MMX, movq
+	KERN_COPY_MMX	bpp, NT, movntq
+	endm
+
+	KERN_CONV24_MMX	MMX, movq
+	KERN_CONV24_MMX	NT, movntq
+
+_TEXT	ends
+
+end
@@ -44,15 +44,175 @@ typedef struct {
 } MODEDESC, FAR *LPMODEDESC;
 
 
-extern WORD FixModeInfo( LPMODEDESC lpMode );
+extern WORD FixModeInfo( LPMODEDESC lpMode, WORD bLowRes );
 extern int PhysicalEnable( void );
 extern void FAR SetRAMDAC_far( UINT bStart, UINT bCount, RGBQUAD FAR *lpPal );
-extern DWORD ReadDisplayConfig( void );
+extern DWORD ReadDisplayConfig( WORD bLowRes );
 extern void FAR RestoreDesktopMode( void );
+extern void FixVirtualSize( void );
+extern WORD CalcPitch( WORD x, WORD bpp );
+extern void PanFollow( int x, int y );
 extern FARPROC RepaintFunc;
 extern void HookInt2Fh( void );
 extern void UnhookInt2Fh( void );
 
+/* Fun times. Undocumented function to create a writable alias of a code
+ * selector. In MS KB Q67165, Microsoft claimed that the function "is not
+ * documented and will not be supported in future versions of Windows".
+ * Clearly they lied, as it happily works on Win9x.
+ */
+extern UINT WINAPI AllocCStoDSAlias( UINT selCode );
+
+/* Typed versions of the DIBENGINE surface access callbacks. */
+typedef void (WINAPI *BEGINACCESSPROC)( LPPDEVICE lpDevice, WORD wLeft, WORD wTop,
+                                        WORD wRight, WORD wBottom, WORD wFlags );
+typedef void (WINAPI *ENDACCESSPROC)( LPPDEVICE lpDevice, WORD wFlags );
+
+/* Accelerated BitBlt callback, see dibcall.c. */
+typedef BOOL (WINAPI *BITBLTPROC)( LPDIBENGINE, WORD, WORD, LPPDEVICE, WORD, WORD,
+                                   WORD, WORD, DWORD, LPBRUSH, LPDRAWMODE );
+extern BITBLTPROC BitBltDevProc;
+
+/* Compiled ROP3 BitBlt (rop3.c). */
+extern void Rop3Init( void );
+extern void Rop3Term( void );
+extern BOOL WINAPI Rop3BitBlt( LPDIBENGINE lpDestDev, WORD wDestX, WORD wDestY, LPPDEVICE lpSrcDev,
+                               WORD wSrcX, WORD wSrcY, WORD wXext, WORD wYext, DWORD dwRop3,
+                               LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode );
+
+/* Parameters of the framebuffer kernels (kernels.asm). Must match
+ * the KJ_xxx offsets in kernels.asm!
+ */
+typedef struct {
+    WORD    wDstSel;        /* Destination selector. */
+    WORD    wSrcSel;        /* Source selector. */
+    DWORD   dwDstOfs;       /* Offset of first destination pixel. */
+    long    lDstPitch;      /* Destination scanline delta. */
+    DWORD   dwSrcOfs;       /* Offset of first source pixel. */
+    long    lSrcPitch;      /* Source scanline delta. */
+    WORD    wWidth;         /* Width in pixels. */
+    WORD    wHeight;        /* Height in scanlines. */
+    DWORD   dwColor;        /* Fill or foreground color. */
+    DWORD   dwBgColor;      /* Background color. */
+    WORD    wSrcBit;        /* First source bit (mono sources). */
+    WORD    wPatRow;        /* First pattern row (0-7). */
+    WORD    wPatStep;       /* Pattern row step, 1 or -1. */
+    WORD    pPat;           /* Near pointer to 8 64-byte pattern rows. */
+    long    lErr;           /* Line error term, below lErrDec. */
+    long    lErrInc;        /* Line error increment per pixel. */
+    long    lErrDec;        /* Line error limit for a minor step. */
+    WORD    wStyle;         /* Line style mask, MSB first. */
+    WORD    wLineOp;        /* Line LOP_xxx flags. */
+    WORD    wAuxSel;        /* Lookup table selector. */
+    WORD    wPatCol;        /* First pattern column (0-7). */
+} KERNJOB;
+
+/* Line kernel flags. */
+#define LOP_XOR     0x0001  /* XOR colors into the destination. */
+#define LOP_OPAQUE  0x0002  /* Draw style gaps in background color. */
+
+typedef void (*KERNPROC)( void );
+
+/* Kernels for the current color depth, filled in by PhysicalEnable.
+ * Entries are NULL where no kernel exists.
+ */
+typedef struct {
+    KERNPROC    pfnFill;        /* Solid fill. */
+    KERNPROC    pfnCopy;        /* Copy, left to right. */
+    KERNPROC    pfnCopyBack;    /* Copy, right to left. */
+    KERNPROC    pfnPat;         /* 8x8 pattern fill. */
+    KERNPROC    pfnMono;        /* Monochrome to color expansion (opaque). */
+    KERNPROC    pfnConv24;      /* Conversion from 24bpp RGB. */
+    KERNPROC    pfnHatch;       /* Transparent hatch (mask) fill. */
+    KERNPROC    pfnXor;         /* XOR with a solid color. */
+    KERNPROC    pfnLine;        /* Bresenham line. */
+    KERNPROC    pfnPatXor;      /* XOR with an 8x8 pattern. */
+    KERNPROC    pfnMonoTr;      /* Monochrome to color expansion (transparent). */
+    KERNPROC    pfnDouble;      /* Copy with pixels doubled, see ShadowFlush. */
+} KERNTAB;
+
+extern KERNJOB  KernJob;
+extern KERNTAB  Kern;
+
+/* Pattern brush fills (pattern.c). */
+extern DWORD PatRows[8][16];
+extern WORD PatBuild( DIB_Brush8 FAR *lpBrush, WORD wX, WORD wPixBytes );
+extern int  PatSelect( LPDIBENGINE lpDev, LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode );
+extern int  PatSelectXor( LPDIBENGINE lpDev, LPBRUSH lpPBrush );
+extern void PatFillRect( WORD wX, WORD wY, WORD wXext, WORD wYext );
+
+/* Monochrome to color expansion (mono.c). */
+extern void MonoSetColors( WORD wBpp, DWORD dwFgColor, DWORD dwBgColor );
+extern void MonoExpand( LPDIBENGINE lpDev, WORD wX, WORD wY, WORD wXext, WORD wYext, WORD wSrcSel,
+                        DWORD dwSrcOfs, WORD wSrcBit, long lSrcPitch, int bTransparent );
+
+/* Inverse colormap for 8bpp (palmap.c). */
+extern void InvMapInvalidate( WORD wStart, WORD wCount );
+extern WORD InvMapUpdate( void );
+extern void KernMap24to8( void );
+extern void KernMap32to8( void );
+extern void KernXlat8( void );
+
+/* Ordered dither for non-palettized 8bpp (dib.c). The fixed color table
+ * holds a color cube with this many levels per component in entries 10 up.
+ */
+#define CUBE_LEVELS     6
+
+extern BYTE DitherTab[64];
+extern BYTE DitherClamp[];
+extern void KernDither24to8( void );
+extern void KernDither32to8( void );
+
+/* Realized object and color cache (objcache.c). */
+extern void ObjCacheFlush( void );
+
+/* Software cursor (cursor.c). */
+extern void WINAPI __loadds CursorBeginAccess( LPDIBENGINE lpDev, WORD wLeft, WORD wTop, WORD wRight,
+                                              WORD wBottom, WORD wFlags );
+extern void WINAPI __loadds CursorEndAccess( LPDIBENGINE lpDev, WORD wFlags );
+extern void CursorReset( void );
+extern void CursorExclude( LPDIBENGINE lpDev, int iLeft, int iTop, int iRight, int iBottom );
+extern void CursorUnexclude( LPDIBENGINE lpDev );
+extern void CursorCacheFlush( void );
+extern WORD wAccessLock;            /* Screen access nesting. */
+
+/* Shadow framebuffer (shadow.c). */
+extern WORD ShadowAlloc( WORD wWidth, WORD wHeight, WORD wBitsPixel, WORD wPitch );
+extern void ShadowStop( void );
+extern void ShadowInvalidate( void );
+extern void ShadowDirty( int iLeft, int iTop, int iRight, int iBottom );
+extern void ShadowFlush( void );
+extern void ShadowFlushRect( int iLeft, int iTop, int iRight, int iBottom );
+extern WORD wShadowFB;              /* Shadow framebuffer requested. */
+extern WORD wShadowSel;             /* Shadow surface, zero if none. */
+extern WORD wPixelDouble;           /* Pixel doubling requested. */
+extern WORD wDoubled;               /* Screen is twice the GDI size. */
+
+/* Damage tracking for applications (damage.c). */
+extern void DamageAdd( int iLeft, int iTop, int iRight, int iBottom );
+extern void DamageReset( void );
+extern int  DamageEscape( WORD wFunction, LPVOID lpInData, LPVOID lpOutData );
+
+/* Screen snapshots for applications (snap.c). */
+extern int  SnapEscape( LPVOID lpInData, LPVOID lpOutData );
+extern DWORD SnapLo[256];
+extern DWORD SnapHi[256];
+extern void KernSnap8to24( void );
+extern void KernSnap8to32( void );
+extern void KernSnap16to24( void );
+extern void KernSnap16to32( void );
+extern void KernSnap24to24( void );
+extern void KernSnap24to32( void );
+extern void KernSnap32to24( void );
+extern void KernSnap32to32( void );
+
+/* CPU features relevant to the kernels, see DriverInit. */
+#define CPU_MMX     0x0001  /* MMX instructions. */
+#define CPU_SSE     0x0002  /* SSE, in particular MOVNTQ and SFENCE. */
+#define CPU_TSC     0x0004  /* RDTSC instruction. */
+
+extern WORD wCpuFeatures;
+
 #ifdef DBGPRINT
 extern void dbg_printf( const char *s, ... );
 #else
@@ -69,9 +229,14 @@ extern WORD wDpi;                   /* Current DPI. */
 extern WORD wBpp;                   /* Current bits per pixel. */
 extern WORD wScrX;                  /* Configured X resolution. */
 extern WORD wScrY;                  /* Configured Y resolution. */
+extern WORD wVirtX;                 /* Configured desktop width. */
+extern WORD wVirtY;                 /* Configured desktop height. */
 extern WORD wScreenX;               /* Screen width in pixels. */
 extern WORD wScreenY;               /* Screen height in pixels. */
+extern WORD wScreenPitchBytes;      /* Screen scanline pitch. */
+extern WORD wPitchAlign;            /* Pitch alignment in bytes. */
 extern WORD wEnabled;               /* PDevice enabled flag. */
+extern WORD wBigFonts;              /* Fonts are in 3.0 format. */
 extern RGBQUAD FAR *lpColorTable;   /* Current color table. */
 
 extern DWORD    VDDEntryPoint;
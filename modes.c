@@ -37,6 +37,14 @@ THE SOFTWARE.
 #define RES_MAX_X   (5 * 1024)
 #define RES_MAX_Y   (5 * 768)
 
+/* Smallest desktop resolution, and smallest resolution for full-screen
+ * applications, see FixModeInfo.
+ */
+#define RES_MIN_X   640
+#define RES_MIN_Y   480
+#define LORES_MIN_X 320
+#define LORES_MIN_Y 200
+
 
 /* Generic DPMI calls, only used in this module. */
 extern WORD DPMI_AllocLDTDesc( WORD cSelectors );
@@ -84,16 +92,173 @@ extern DWORD DPMI_MapPhys( DWORD Base, DWORD Size );
     parm [cx bx] [di si];
 
 
+/* Framebuffer kernels in kernels.asm. */
+extern void KernFill8( void );
+extern void KernCopy8( void );
+extern void KernCopyBack8( void );
+extern void KernPat8( void );
+extern void KernMono8( void );
+extern void KernHatch8( void );
+extern void KernXor8( void );
+extern void KernLine8( void );
+extern void KernPatXor8( void );
+extern void KernMonoTr8( void );
+extern void KernDouble8( void );
+extern void KernFill16( void );
+extern void KernCopy16( void );
+extern void KernCopyBack16( void );
+extern void KernPat16( void );
+extern void KernMono16( void );
+extern void KernConv24to16( void );
+extern void KernHatch16( void );
+extern void KernXor16( void );
+extern void KernLine16( void );
+extern void KernPatXor16( void );
+extern void KernMonoTr16( void );
+extern void KernDouble16( void );
+extern void KernFill24( void );
+extern void KernCopy24( void );
+extern void KernCopyBack24( void );
+extern void KernPat24( void );
+extern void KernMono24( void );
+extern void KernHatch24( void );
+extern void KernXor24( void );
+extern void KernLine24( void );
+extern void KernPatXor24( void );
+extern void KernMonoTr24( void );
+extern void KernDouble24( void );
+extern void KernFill32( void );
+extern void KernCopy32( void );
+extern void KernCopyBack32( void );
+extern void KernPat32( void );
+extern void KernMono32( void );
+extern void KernConv24to32( void );
+extern void KernHatch32( void );
+extern void KernXor32( void );
+extern void KernLine32( void );
+extern void KernPatXor32( void );
+extern void KernMonoTr32( void );
+extern void KernDouble32( void );
+
+/* Kernels for each color depth, indexed by bpp / 8. There are no kernels
+ * below 8bpp. At 24bpp, conversion from 24bpp is a plain copy; at 8bpp,
+ * it would require color matching.
+ */
+static const KERNTAB KernTabs[] = {
+    { NULL },
+    { KernFill8,  KernCopy8,  KernCopyBack8,  KernPat8,  KernMono8,  NULL,           KernHatch8,  KernXor8,  KernLine8,  KernPatXor8,  KernMonoTr8,  KernDouble8  },
+    { KernFill16, KernCopy16, KernCopyBack16, KernPat16, KernMono16, KernConv24to16, KernHatch16, KernXor16, KernLine16, KernPatXor16, KernMonoTr16, KernDouble16 },
+    { KernFill24, KernCopy24, KernCopyBack24, KernPat24, KernMono24, KernCopy24,     KernHatch24, KernXor24, KernLine24, KernPatXor24, KernMonoTr24, KernDouble24 },
+    { KernFill32, KernCopy32, KernCopyBack32, KernPat32, KernMono32, KernConv24to32, KernHatch32, KernXor32, KernLine32, KernPatXor32, KernMonoTr32, KernDouble32 }
+};
+
+/* MMX kernels in kernmmx.asm. */
+extern void KernFillMMX8( void );
+extern void KernCopyMMX8( void );
+extern void KernFillMMX16( void );
+extern void KernCopyMMX16( void );
+extern void KernCopyMMX24( void );
+extern void KernFillMMX32( void );
+extern void KernCopyMMX32( void );
+extern void KernConv24to32MMX( void );
+extern void KernFillNT8( void );
+extern void KernCopyNT8( void );
+extern void KernFillNT16( void );
+extern void KernCopyNT16( void );
+extern void KernCopyNT24( void );
+extern void KernFillNT32( void );
+extern void KernCopyNT32( void );
+extern void KernConv24to32NT( void );
+
+/* MMX kernels which replace the above where not NULL, when the CPU
+ * supports MMX or SSE (for MOVNTQ), respectively.
+ */
+static const KERNTAB KernTabsMMX[] = {
+    { NULL },
+    { KernFillMMX8,  KernCopyMMX8,  NULL, NULL, NULL, NULL              },
+    { KernFillMMX16, KernCopyMMX16, NULL, NULL, NULL, NULL              },
+    { NULL,          KernCopyMMX24, NULL, NULL, NULL, KernCopyMMX24     },
+    { KernFillMMX32, KernCopyMMX32, NULL, NULL, NULL, KernConv24to32MMX }
+};
+
+static const KERNTAB KernTabsNT[] = {
+    { NULL },
+    { KernFillNT8,  KernCopyNT8,  NULL, NULL, NULL, NULL             },
+    { KernFillNT16, KernCopyNT16, NULL, NULL, NULL, NULL             },
+    { NULL,         KernCopyNT24, NULL, NULL, NULL, KernCopyNT24     },
+    { KernFillNT32, KernCopyNT32, NULL, NULL, NULL, KernConv24to32NT }
+};
+
+/* Unrolled kernels in kernels.asm. */
+extern void KernFillUnr8( void );
+extern void KernCopyUnr8( void );
+extern void KernFillUnr16( void );
+extern void KernCopyUnr16( void );
+extern void KernCopyUnr24( void );
+extern void KernFillUnr32( void );
+extern void KernCopyUnr32( void );
+
+static const KERNTAB KernTabsUnr[] = {
+    { NULL },
+    { KernFillUnr8,  KernCopyUnr8  },
+    { KernFillUnr16, KernCopyUnr16 },
+    { NULL,          KernCopyUnr24 },
+    { KernFillUnr32, KernCopyUnr32 }
+};
+
+/* Fill and copy kernel flavors, as stored in SYSTEM.INI. Which one is
+ * fastest depends on the host, so it is measured (see SelectKernels).
+ */
+#define KERN_REP        1   /* REP STOSD/MOVSD. */
+#define KERN_UNROLL     2   /* Unrolled MOV loop. */
+#define KERN_MMX        3   /* MMX MOVQ. */
+#define KERN_NT         4   /* MMX MOVNTQ, needs SSE. */
+#define KERN_FLAVORS    4
+
+static const KERNTAB * const KernFlavors[KERN_FLAVORS] = {
+    KernTabs, KernTabsUnr, KernTabsMMX, KernTabsNT
+};
+
+/* Operations subject to calibration, as indexes into KERNTAB. */
+#define KERN_OP_FILL    0
+#define KERN_OP_COPY    1
+
+/* Size of the VRAM areas used for calibration. */
+#define CALIB_PITCH     512
+#define CALIB_ROWS      32
+#define CALIB_SIZE      ((DWORD)CALIB_PITCH * CALIB_ROWS)
+
+KERNJOB KernJob;
+KERNTAB Kern;
+
 WORD wScreenX       = 0;
 WORD wScreenY       = 0;
-WORD BitBltDevProc  = 0;
+BITBLTPROC BitBltDevProc = NULL;
 WORD ScreenSelector = 0;
 WORD wPDeviceFlags  = 0;
+WORD wScreenPitchBytes = 0;
+WORD wPitchAlign    = 64;
 
 static DWORD    dwScreenFlatAddr = 0;   /* 32-bit flat address of VRAM. */
 static DWORD    dwVideoMemorySize = 0;  /* Installed VRAM in bytes. */
-static WORD     wScreenPitchBytes = 0;  /* Current scanline pitch. */
 static DWORD    dwPhysVRAM = 0;         /* Physical LFB base address. */
+/* Adapter capabilities, detected once (see DetectHardware). */
+static WORD     wChipID  = 0;           /* DISPI ID, zero if not detected. */
+static WORD     wCapsX   = RES_MAX_X;   /* Largest supported resolution. */
+static WORD     wCapsY   = RES_MAX_Y;
+static WORD     wCapsBpp = 32;          /* Deepest supported color depth. */
+
+/* Standard modes the adapter can set, see BOXV_mode_enumerate(). */
+#define MODE_MAX    64
+static BOXV_mode_t  ModeTab[MODE_MAX];
+static WORD         wModes = 0;
+
+static WORD     wVramRows = 0;          /* Scanlines of VRAM in use. */
+static WORD     wViewX = 0;             /* Visible part of the desktop. */
+static WORD     wViewY = 0;
+static WORD     wPanX  = 0;             /* Current display start. */
+static WORD     wPanY  = 0;
+static WORD     bModeSet = 0;           /* DISPI registers being written. */
 
 /* These are currently calculated not needed in the absence of
  * offscreen video memory.
@@ -101,6 +266,15 @@ static DWORD    dwPhysVRAM = 0;         /* Physical LFB base address. */
 static WORD wMaxWidth  = 0;
 static WORD wMaxHeight = 0;
 
+/* Read the low dword of the time stamp counter. */
+extern DWORD ReadTSC( void );
+#pragma aux ReadTSC =   \
+    ".586"              \
+    "rdtsc"             \
+    "mov    edx, eax"   \
+    "shr    edx, 16"    \
+    value [dx ax];
+
 /* On Entry:
  * EAX   = Function code (VDD_DRIVER_REGISTER)
  * EBX   = This VM's handle
@@ -133,10 +307,14 @@ extern DWORD CallVDDRegister( WORD Function, WORD wPitch, WORD wHeight, void _fa
 
 /* Take a mode descriptor and change it to be a valid
  * mode if it isn't already. Return zero if mode needed
- * fixing (wasn't valid).
+ * fixing (wasn't valid). Resolutions below 640x480 are
+ * only valid if bLowRes is set.
  */
-WORD FixModeInfo( LPMODEDESC lpMode )
+WORD FixModeInfo( LPMODEDESC lpMode, WORD bLowRes )
 {
+    WORD    wMinX = bLowRes ? LORES_MIN_X : RES_MIN_X;
+    WORD    wMinY = bLowRes ? LORES_MIN_Y : RES_MIN_Y;
+
     WORD    rc = 1; /* Assume valid mode. */
 
     /* First validate bits per pixel. */
@@ -151,10 +329,10 @@ WORD FixModeInfo( LPMODEDESC lpMode )
         rc = 0;             /* Mode wasn't valid. */
     }
 
-    /* Validate mode. If resolution is under 640x480 in
+    /* Validate mode. If resolution is under the minimum in
      * either direction, force 640x480.
      */
-    if( lpMode->xRes < 640 || lpMode->yRes < 480 )
+    if( lpMode->xRes < wMinX || lpMode->yRes < wMinY )
     {
         lpMode->xRes = 640; /* Force 640x480. */
         lpMode->yRes = 480;
@@ -177,44 +355,139 @@ WORD FixModeInfo( LPMODEDESC lpMode )
 }
 
 
-/* Calculate pitch for a given horizontal resolution and bpp. */
+/* Calculate pitch for a given horizontal resolution and bpp. The pitch
+ * is a multiple of wPitchAlign bytes so that scanlines start on cache
+ * line boundaries. It is also a whole number of pixels, because the
+ * hardware takes it as the virtual width (for 24bpp, the width is
+ * aligned to wPitchAlign pixels).
+ */
 WORD CalcPitch( WORD x, WORD bpp )
 {
-    WORD    wPitch;
+    WORD    wBytes = bpp / 8;   /* Valid BPP is a multiple of 8. */
+    WORD    wAlign = wPitchAlign;
+
+    if( !(wBytes & 1) )
+        wAlign /= wBytes;
 
-    /* Valid BPP must be a multiple of 8 so it's simple. */
-    wPitch = x * (bpp / 8);
+    return( ((x + wAlign - 1) & ~(wAlign - 1)) * wBytes );
+}
 
-    /* Align to 32 bits. */
-    wPitch = (wPitch + 3) & ~3;
 
-    return( wPitch );
+/* Add a standard mode to ModeTab if the adapter can set it. */
+static int ModeTabAdd( void *cx, BOXV_mode_t *mode )
+{
+    if( (WORD)mode->xres <= wCapsX && (WORD)mode->yres <= wCapsY && (WORD)mode->bpp <= wCapsBpp
+      && (DWORD)CalcPitch( mode->xres, mode->bpp ) * mode->yres <= dwVideoMemorySize )
+        ModeTab[wModes++] = *mode;
+    return( wModes < MODE_MAX );
 }
 
 
-/* Return non-zero if given mode is supported. */
-static int IsModeOK( WORD wXRes, WORD wYRes, WORD wBpp )
+/* Detect the adapter, its limits and VRAM size, and build the table of
+ * standard modes. The hardware does not change, so this is only done
+ * once. Returns zero if there is no supported adapter.
+ */
+static int DetectHardware( void )
 {
-    MODEDESC    mode;
-    DWORD       dwModeMem;
+    int     iMaxX, iMaxY, iMaxBpp;
 
-    mode.bpp  = wBpp;
-    mode.xRes = wXRes;
-    mode.yRes = wYRes;
+    if( wChipID )
+        return( 1 );
 
-    /* If mode needed fixing, it's not valid. */
-    if( !FixModeInfo( &mode ) )
+    wChipID = BOXV_detect( 0, &dwVideoMemorySize );
+    if( !wChipID )
         return( 0 );
 
-    /* Make sure there's enough VRAM for it. */
-    dwModeMem = (DWORD)CalcPitch( wXRes, wBpp ) * wYRes;
-    if( dwModeMem > dwVideoMemorySize )
-        return( 0 );
+    /* Older adapters cannot report their limits; assume ours. Implausible
+     * values are ignored too.
+     */
+    if( !BOXV_get_caps( 0, &iMaxX, &iMaxY, &iMaxBpp )
+      && iMaxX >= 640 && iMaxY >= 480 && iMaxBpp >= 8 ) {
+        if( (WORD)iMaxX < wCapsX )
+            wCapsX = iMaxX;
+        if( (WORD)iMaxY < wCapsY )
+            wCapsY = iMaxY;
+        if( (WORD)iMaxBpp < wCapsBpp )
+            wCapsBpp = iMaxBpp;
+    }
+
+    BOXV_mode_enumerate( 0, ModeTabAdd );
 
+    dbg_printf( "DetectHardware: ID=%X dwVideoMemorySize=%lX\n", wChipID, dwVideoMemorySize );
+    dbg_printf( "DetectHardware: max %ux%u %ubpp, %u standard modes\n", wCapsX, wCapsY, wCapsBpp, wModes );
     return( 1 );
 }
 
 
+/* Return non-zero if given mode is supported. Needs DetectHardware().
+ * Low resolutions are allowed here; the desktop floor is enforced when
+ * the configuration is read (FixModeInfo).
+ */
+static int IsModeOK( WORD wXRes, WORD wYRes, WORD wBpp )
+{
+    WORD    i;
+
+    switch( wBpp ) {
+    case 8:
+    case 16:
+    case 24:
+    case 32:
+        break;
+    default:
+        return( 0 );
+    }
+    if( wXRes < LORES_MIN_X || wYRes < LORES_MIN_Y )
+        return( 0 );
+
+    for( i = 0; i < wModes; ++i )
+        if( (WORD)ModeTab[i].xres == wXRes && (WORD)ModeTab[i].yres == wYRes && (WORD)ModeTab[i].bpp == wBpp )
+            return( 1 );
+
+    /* Not a standard mode; check it against the adapter's limits. */
+    if( wXRes > wCapsX || wYRes > wCapsY || wBpp > wCapsBpp )
+        return( 0 );
+    return( (DWORD)CalcPitch( wXRes, wBpp ) * wYRes <= dwVideoMemorySize );
+}
+
+
+/* Make the desktop size (wVirtX/wVirtY) usable with the current mode:
+ * no smaller than the screen, and no larger than VRAM allows. A desktop
+ * that does not fit is reduced to the screen size, i.e. no panning.
+ */
+void FixVirtualSize( void )
+{
+    /* With pixel doubling, GDI gets half the mode in each direction (see
+     * ShadowFlush), as long as that is still a usable desktop. There is
+     * no panning then.
+     */
+    wDoubled = wPixelDouble && wScrX / 2 >= RES_MIN_X && wScrY / 2 >= RES_MIN_Y;
+    if( wDoubled ) {
+        wVirtX = wScrX / 2;
+        wVirtY = wScrY / 2;
+        return;
+    }
+
+    /* Low resolution modes are for full-screen applications. */
+    if( wScrX < RES_MIN_X || wScrY < RES_MIN_Y ) {
+        wVirtX = wScrX;
+        wVirtY = wScrY;
+    }
+    if( wVirtX < wScrX )
+        wVirtX = wScrX;
+    if( wVirtY < wScrY )
+        wVirtY = wScrY;
+
+    DetectHardware();
+
+    if( wVirtX > wCapsX || wVirtY > wCapsY
+      || (DWORD)CalcPitch( wVirtX, wBpp ) * wVirtY > dwVideoMemorySize ) {
+        dbg_printf( "FixVirtualSize: %ux%u does not fit\n", wVirtX, wVirtY );
+        wVirtX = wScrX;
+        wVirtY = wScrY;
+    }
+}
+
+
 /* Clear the visible screen by setting it to all black (zeros).
  * NB: Assumes there is no off-screen region to the right of
  * the visible area.
@@ -222,7 +495,7 @@ static int IsModeOK( WORD wXRes, WORD wYRes, WORD wBpp )
 static void ClearVisibleScreen( void )
 {
     LPDWORD     lpScr;
-    WORD        wLines = wScreenY;
+    WORD        wLines = wVramRows;
     WORD        i;
 
     lpScr = ScreenSelector :> 0;
@@ -263,19 +536,36 @@ static DWORD AllocLinearSelector( DWORD dwPhysAddr, DWORD dwSize )
  */
 static int SetDisplayMode( WORD wXRes, WORD wYRes, int bFullSet )
 {
+    WORD    x, y;
+
     dbg_printf( "SetDisplayMode: wXRes=%u wYRes=%u\n", wXRes, wYRes );
 
+    /* Keep PanFollow off the DISPI registers until the mode is set. */
+    bModeSet = 1;
+
+    /* The desktop may be larger than the screen, see PanFollow, or
+     * smaller and doubled, see ShadowFlush. VRAM holds whichever is
+     * larger. The virtual width also sets the pitch.
+     */
+    if( bFullSet ) {
+        wScreenPitchBytes = CalcPitch( wDoubled ? wXRes : wVirtX, wBpp );
+        wVramRows         = wDoubled ? wYRes : wVirtY;
+    }
+
     /* Inform the VDD that the mode is about to change. */
     CallVDD( VDD_PRE_MODE_CHANGE );
 
-    BOXV_ext_mode_set( 0, wXRes, wYRes, wBpp, wXRes, wYRes );
+    BOXV_ext_mode_set( 0, wXRes, wYRes, wBpp, wScreenPitchBytes / (wBpp / 8), wVramRows );
 
     if( bFullSet ) {
-        wScreenX = wXRes;
-        wScreenY = wYRes;
-
-        wScreenPitchBytes = CalcPitch( wXRes, wBpp );
-        BitBltDevProc     = NULL;       /* No acceleration implemented. */
+        wViewX   = wXRes;
+        wViewY   = wYRes;
+        wPanX    = 0;
+        wPanY    = 0;
+        wScreenX = wVirtX;
+        wScreenY = wVirtY;
+
+        BitBltDevProc     = Rop3BitBlt; /* Compiled ROP3 BitBlt. */
         wPDeviceFlags     = MINIDRIVER | VRAM;
         if( wBpp == 16 ) {
             wPDeviceFlags |= FIVE6FIVE; /* Needed for 16bpp modes. */
@@ -286,6 +576,19 @@ static int SetDisplayMode( WORD wXRes, WORD wYRes, int bFullSet )
 
         /* Offscreen regions could be calculated here. We do not use those. */
     }
+
+    /* Apply the display start, including any recorded by PanFollow
+     * meanwhile; if it moves again before the flag is cleared, repeat.
+     */
+    for( ;; ) {
+        x = wPanX;
+        y = wPanY;
+        BOXV_pan_set( 0, x, y );
+        bModeSet = 0;
+        if( x == wPanX && y == wPanY )
+            break;
+        bModeSet = 1;
+    }
     return( 1 );
 }
 
@@ -293,21 +596,169 @@ static int SetDisplayMode( WORD wXRes, WORD wYRes, int bFullSet )
 /* Forward declaration. */
 void __far RestoreDesktopMode( void );
 
-int PhysicalEnable( void )
+/* Replace the current kernels with those in pTab which are not NULL. */
+static void KernOverride( const KERNTAB *pTab )
 {
-    DWORD   dwRegRet;
+    const KERNPROC  *pSrc = (const KERNPROC *)pTab;
+    KERNPROC        *pDst = (KERNPROC *)&Kern;
+    int             i;
 
-    if( !ScreenSelector ) {
-        int     iChipID;
+    for( i = 0; i < sizeof( KERNTAB ) / sizeof( KERNPROC ); ++i )
+        if( pSrc[i] )
+            pDst[i] = pSrc[i];
+}
 
-        /* Extra work if driver hasn't yet been initialized. */
-        iChipID = BOXV_detect( 0, &dwVideoMemorySize );
-        if( !iChipID ) {
-            return( 0 );
+/* Check if a kernel flavor is valid and supported by the CPU. */
+static int KernFlavorOK( WORD wFlavor )
+{
+    if( wFlavor < KERN_REP || wFlavor > KERN_FLAVORS )
+        return( 0 );
+    if( wFlavor >= KERN_MMX && !(wCpuFeatures & CPU_MMX) )
+        return( 0 );
+    if( wFlavor == KERN_NT && !(wCpuFeatures & CPU_SSE) )
+        return( 0 );
+    return( 1 );
+}
+
+/* Return the kernel of a given flavor for an operation at the current
+ * color depth, or NULL if there is none.
+ */
+static KERNPROC KernFlavorProc( WORD wFlavor, WORD wOp )
+{
+    if( !KernFlavorOK( wFlavor ) )
+        return( NULL );
+    return( ((const KERNPROC *)&KernFlavors[wFlavor - 1][wBpp >> 3])[wOp] );
+}
+
+/* Time a kernel; the best of a few runs counts. */
+static DWORD KernTime( KERNPROC pfnKern )
+{
+    DWORD   dwBest = 0xFFFFFFFF;
+    DWORD   dwStart;
+    DWORD   dwTime;
+    int     i;
+
+    for( i = 0; i < 4; ++i ) {
+        dwStart = ReadTSC();
+        pfnKern();
+        dwTime = ReadTSC() - dwStart;
+        if( dwTime < dwBest )
+            dwBest = dwTime;
+    }
+    return( dwBest );
+}
+
+/* Find the fastest flavor of an operation. The first calibration area
+ * in offscreen VRAM is the source, the second one the destination.
+ */
+static WORD KernCalibrate( WORD wOp, DWORD dwCalibOfs )
+{
+    KERNPROC    pfnKern;
+    DWORD       dwTime;
+    DWORD       dwBest = 0xFFFFFFFF;
+    WORD        wBest = KERN_REP;
+    WORD        wFlavor;
+
+    KernJob.wDstSel   = ScreenSelector;
+    KernJob.wSrcSel   = ScreenSelector;
+    KernJob.dwSrcOfs  = dwCalibOfs;
+    KernJob.dwDstOfs  = dwCalibOfs + CALIB_SIZE;
+    KernJob.lSrcPitch = CALIB_PITCH;
+    KernJob.lDstPitch = CALIB_PITCH;
+    KernJob.wWidth    = CALIB_PITCH / (wBpp >> 3);
+    KernJob.wHeight   = CALIB_ROWS;
+    KernJob.dwColor   = 0;
+
+    for( wFlavor = KERN_REP; wFlavor <= KERN_FLAVORS; ++wFlavor ) {
+        pfnKern = KernFlavorProc( wFlavor, wOp );
+        if( !pfnKern )
+            continue;
+        dwTime = KernTime( pfnKern );
+        dbg_printf( "KernCalibrate: op %u flavor %u took %lu ticks\n", wOp, wFlavor, dwTime );
+        if( dwTime < dwBest ) {
+            dwBest = dwTime;
+            wBest  = wFlavor;
         }
-        dwPhysVRAM = LfbBase;
-        dbg_printf( "PhysicalEnable: Hardware detected, dwVideoMemorySize=%lX dwPhysVRAM=%lX\n", dwVideoMemorySize, dwPhysVRAM );
     }
+    return( wBest );
+}
+
+/* Pick the kernel for an operation. A flavor forced in SYSTEM.INI wins,
+ * then one recorded by an earlier calibration. If neither is usable,
+ * calibrate (if possible) and record the result.
+ */
+static void KernPick( WORD wOp, const char *pszKey, DWORD dwCalibOfs )
+{
+    KERNPROC    *pKern = &((KERNPROC *)&Kern)[wOp];
+    KERNPROC    pfnKern;
+    WORD        wFlavor;
+    char        szFlavor[2];
+
+    wFlavor = GetPrivateProfileInt( "display", "ForceKernel", 0, "system.ini" );
+    if( !KernFlavorProc( wFlavor, wOp ) )
+        wFlavor = GetPrivateProfileInt( "display", pszKey, 0, "system.ini" );
+
+    /* A recorded flavor may legitimately lack a kernel at this depth. */
+    if( !KernFlavorOK( wFlavor ) ) {
+        if( !dwCalibOfs )
+            return;     /* Keep the default. */
+        wFlavor = KernCalibrate( wOp, dwCalibOfs );
+        szFlavor[0] = '0' + wFlavor;
+        szFlavor[1] = '\0';
+        WritePrivateProfileString( "display", pszKey, szFlavor, "system.ini" );
+    }
+
+    pfnKern = KernFlavorProc( wFlavor, wOp );
+    if( pfnKern )
+        *pKern = pfnKern;
+    dbg_printf( "KernPick: %s=%u\n", pszKey, wFlavor );
+}
+
+/* SYSTEM.INI keys for the calibrated flavors, by bytes per pixel. The
+ * fastest flavor differs between depths, so each has its own.
+ */
+static const char * const FillKeys[] = {
+    NULL, "FillKernel8", "FillKernel16", "FillKernel24", "FillKernel32"
+};
+static const char * const CopyKeys[] = {
+    NULL, "CopyKernel8", "CopyKernel16", "CopyKernel24", "CopyKernel32"
+};
+
+/* Select the kernels for the current color depth. The depth only
+ * changes across PhysicalEnable calls, so kernels need not check it.
+ */
+static void SelectKernels( void )
+{
+    WORD    wIdx = wBpp >> 3;
+    DWORD   dwCalibOfs = 0;
+
+    /* Start with the best kernels the CPU supports. */
+    Kern = KernTabs[wIdx];
+    if( wCpuFeatures & CPU_SSE )
+        KernOverride( &KernTabsNT[wIdx] );
+    else if( wCpuFeatures & CPU_MMX )
+        KernOverride( &KernTabsMMX[wIdx] );
+
+    if( !wIdx )
+        return;
+
+    /* Calibration needs RDTSC and some offscreen VRAM. */
+    if( wCpuFeatures & CPU_TSC ) {
+        dwCalibOfs = (DWORD)wScreenPitchBytes * wVramRows;
+        if( dwCalibOfs + 2 * CALIB_SIZE > dwVideoMemorySize )
+            dwCalibOfs = 0;
+    }
+
+    KernPick( KERN_OP_FILL, FillKeys[wIdx], dwCalibOfs );
+    KernPick( KERN_OP_COPY, CopyKeys[wIdx], dwCalibOfs );
+}
+
+int PhysicalEnable( void )
+{
+    DWORD   dwRegRet;
+
+    if( !DetectHardware() )
+        return( 0 );
 
     if( !IsModeOK( wScrX, wScrY, wBpp ) ) {
         /* Can't find mode, oopsie. */
@@ -323,6 +774,11 @@ int PhysicalEnable( void )
 
     /* Allocate an LDT selector for the screen. */
     if( !ScreenSelector ) {
+        /* Not known before DriverInit has asked the configuration
+         * manager, which is after the first DetectHardware().
+         */
+        dwPhysVRAM = LfbBase;
+        dbg_printf( "PhysicalEnable: dwPhysVRAM=%lX\n", dwPhysVRAM );
         ScreenSelector = AllocLinearSelector( dwPhysVRAM, dwVideoMemorySize );
         if( !ScreenSelector ) {
             dbg_printf( "PhysicalEnable: AllocScreenSelector failed!\n" );
@@ -330,11 +786,14 @@ int PhysicalEnable( void )
         }
     }
 
+    /* Pick the kernels, before the VDD claims offscreen VRAM. */
+    SelectKernels();
+
     /* NB: Currently not used. DirectDraw would need the segment base. */
     dwScreenFlatAddr = DPMI_GetSegBase( ScreenSelector );   /* Not expected to fail. */
 
     dbg_printf( "PhysicalEnable: RestoreDesktopMode is at %WP\n", RestoreDesktopMode );
-    dwRegRet = CallVDDRegister( VDD_DRIVER_REGISTER, wScreenPitchBytes, wScreenY, RestoreDesktopMode );
+    dwRegRet = CallVDDRegister( VDD_DRIVER_REGISTER, wScreenPitchBytes, wVramRows, RestoreDesktopMode );
     if( dwRegRet != VDD_DRIVER_REGISTER ) {
         /* NB: It's not fatal if CallVDDRegister() fails. */
         /// @todo What can we do with the returned value?
@@ -362,17 +821,10 @@ UINT WINAPI __loadds ValidateMode( DISPVALMODE FAR *lpValMode )
 
     dbg_printf( "ValidateMode: X=%u Y=%u bpp=%u\n", lpValMode->dvmXRes, lpValMode->dvmYRes, lpValMode->dvmBpp );
     do {
-        if( !ScreenSelector ) {
-            int     iChipID;
-
-            /* Additional checks if driver isn't running. */
-            iChipID = BOXV_detect( 0, &dwVideoMemorySize );
-            if( !iChipID ) {
-                rc = VALMODE_NO_WRONGDRV;
-                break;
-            }
-            dwPhysVRAM = LfbBase;
-            dbg_printf( "ValidateMode: Hardware detected, dwVideoMemorySize=%lX dwPhysVRAM=%lX\n", dwVideoMemorySize, dwPhysVRAM );
+        /* Only touches the hardware the first time. */
+        if( !DetectHardware() ) {
+            rc = VALMODE_NO_WRONGDRV;
+            break;
         }
 
         if( !IsModeOK( lpValMode->dvmXRes, lpValMode->dvmYRes, lpValMode->dvmBpp ) ) {
@@ -396,7 +848,7 @@ void __far RestoreDesktopMode( void )
     dbg_printf( "RestoreDesktopMode: %ux%u, wBpp=%u\n", wScreenX, wScreenY, wBpp );
 
     /* Set the current desktop mode again. */
-    SetDisplayMode( wScreenX, wScreenY, 0 );
+    SetDisplayMode( wViewX, wViewY, 0 );
 
     /* Reprogram the DAC if relevant. */
     if( wBpp <= 8 ) {
@@ -416,6 +868,12 @@ void __far RestoreDesktopMode( void )
         SetRAMDAC_far( 0, wPalCnt, lpColorTable );
     }
 
+    /* The cursor went away with the screen contents, which the shadow
+     * framebuffer (if any) still has.
+     */
+    CursorReset();
+    ShadowInvalidate();
+
     /* Clear the busy flag. Quite important. */
     lpDriverPDevice->deFlags &= ~BUSY;
 
@@ -425,3 +883,45 @@ void __far RestoreDesktopMode( void )
     ClearVisibleScreen();
 }
 
+/* Pan the visible part of a desktop larger than the screen so that the
+ * point (x,y), usually the cursor position, is visible. Only the display
+ * start is changed; the desktop is never copied or repainted.
+ * NB: Called from MoveCursor() at interrupt time.
+ */
+void PanFollow( int x, int y )
+{
+    int     iPanX = wPanX;
+    int     iPanY = wPanY;
+
+    if( wDoubled || (wViewX == wScreenX && wViewY == wScreenY) )
+        return;
+
+    if( x < iPanX )
+        iPanX = x;
+    else if( x >= iPanX + (int)wViewX )
+        iPanX = x - wViewX + 1;
+    if( y < iPanY )
+        iPanY = y;
+    else if( y >= iPanY + (int)wViewY )
+        iPanY = y - wViewY + 1;
+
+    if( iPanX < 0 )
+        iPanX = 0;
+    else if( iPanX > (int)(wScreenX - wViewX) )
+        iPanX = wScreenX - wViewX;
+    if( iPanY < 0 )
+        iPanY = 0;
+    else if( iPanY > (int)(wScreenY - wViewY) )
+        iPanY = wScreenY - wViewY;
+
+    if( iPanX == wPanX && iPanY == wPanY )
+        return;
+    wPanX = iPanX;
+    wPanY = iPanY;
+
+    /* While BUSY the hardware is not ours, and during a mode set the
+     * DISPI index must not change under SetDisplayMode; it pans when done.
+     */
+    if( !(lpDriverPDevice->deFlags & BUSY) && !bModeSet )
+        BOXV_pan_set( 0, wPanX, wPanY );
+}
@@ -0,0 +1,103 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* Monochrome to color expansion. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+/* For each possible source byte, the 8 destination pixels it expands
+ * to with the current colors. Entries are 32 bytes long regardless of
+ * the color depth, so that the kernels can index them with a shift.
+ * The table is rebuilt only when the colors or the depth change.
+ */
+static DWORD    MonoTab[256][8];
+static WORD     wMonoBpp;           /* Depth of MonoTab, zero if not built. */
+static DWORD    dwMonoFg;
+static DWORD    dwMonoBg;
+
+/* Set the colors for set (dwFgColor) and clear (dwBgColor) source bits.
+ * The colors are physical colors for the given depth.
+ */
+void MonoSetColors( WORD wBpp, DWORD dwFgColor, DWORD dwBgColor )
+{
+    WORD    wPixBytes = wBpp >> 3;
+    DWORD   dwMask;
+    WORD    i, j, k;
+    BYTE    *pEntry;
+    BYTE    *pColor;
+
+    dwMask = wBpp == 32 ? 0xFFFFFFFF : (1L << wBpp) - 1;
+    dwFgColor &= dwMask;
+    dwBgColor &= dwMask;
+    if( wBpp == wMonoBpp && dwFgColor == dwMonoFg && dwBgColor == dwMonoBg )
+        return;
+
+    dbg_printf( "MonoSetColors: bpp=%u fg=%lX bg=%lX\n", wBpp, dwFgColor, dwBgColor );
+    for( i = 0; i < 256; ++i ) {
+        pEntry = (BYTE *)MonoTab[i];
+        for( j = 0; j < 8; ++j ) {
+            pColor = (BYTE *)(i & (0x80 >> j) ? &dwFgColor : &dwBgColor);
+            for( k = 0; k < wPixBytes; ++k )
+                *pEntry++ = pColor[k];
+        }
+    }
+    wMonoBpp = wBpp;
+    dwMonoFg = dwFgColor;
+    dwMonoBg = dwBgColor;
+}
+
+/* Expand a monochrome bitmap to the destination with the colors set by
+ * MonoSetColors. The source starts at bit wSrcBit (from the MSB) of the
+ * byte at wSrcSel:dwSrcOfs. If bTransparent is set, clear source bits
+ * leave the destination unchanged. The caller is responsible for
+ * clipping and cursor exclusion.
+ */
+void MonoExpand( LPDIBENGINE lpDev, WORD wX, WORD wY, WORD wXext, WORD wYext, WORD wSrcSel,
+                 DWORD dwSrcOfs, WORD wSrcBit, long lSrcPitch, int bTransparent )
+{
+    if( !wXext || !wYext )
+        return;
+
+    KernJob.wDstSel   = lpDev->deBitsSelector;
+    KernJob.lDstPitch = lpDev->deDeltaScan;
+    KernJob.dwDstOfs  = lpDev->deBitsOffset + (long)wY * lpDev->deDeltaScan
+                      + (DWORD)wX * (lpDev->deBitsPixel >> 3);
+    KernJob.wSrcSel   = wSrcSel;
+    KernJob.dwSrcOfs  = dwSrcOfs;
+    KernJob.lSrcPitch = lSrcPitch;
+    KernJob.wSrcBit   = wSrcBit;
+    KernJob.wWidth    = wXext;
+    KernJob.wHeight   = wYext;
+    KernJob.dwColor   = dwMonoFg;
+    KernJob.dwBgColor = dwMonoBg;
+    KernJob.pPat      = (WORD)MonoTab;
+    if( bTransparent )
+        Kern.pfnMonoTr();
+    else
+        Kern.pfnMono();
+}
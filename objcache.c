@@ -0,0 +1,217 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* Cache of realized pens, solid brushes, and physical colors. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+#include <string.h>
+
+/* GDI realizes the same few pens and brushes and maps the same few
+ * colors over and over. The results only depend on the logical color,
+ * the destination pixel format, and the palette, so they are kept in
+ * small direct mapped caches. Entries are tagged with the palette
+ * generation, which is bumped whenever the palette or the palette
+ * translation changes, so stale entries are never hit.
+ */
+
+#define PEN_SLOTS       16
+#define BRUSH_SLOTS     8
+#define COLOR_SLOTS     32
+
+typedef struct {
+    DWORD   dwColor;        /* Logical color. */
+    WORD    wStyle;         /* Pen or brush style. */
+    WORD    wFormat;        /* Destination format, see ObjFormat. */
+    WORD    wGen;           /* Palette generation, zero if unused. */
+    DWORD   dwRet;          /* Value returned by the DIB Engine. */
+} OBJKEY;
+
+typedef struct {
+    OBJKEY  Key;
+    DIB_Pen Pen;
+} PENSLOT;
+
+typedef struct {
+    OBJKEY      Key;
+    DIB_Brush32 Brush;      /* The largest brush. */
+} BRUSHSLOT;
+
+typedef struct {
+    DWORD   dwColor;        /* Logical color. */
+    WORD    wFormat;
+    WORD    wGen;
+    DWORD   dwPhys;         /* Physical color. */
+    DWORD   dwRet;          /* Closest logical color. */
+} COLORSLOT;
+
+static PENSLOT      PenCache[PEN_SLOTS];
+static BRUSHSLOT    BrushCache[BRUSH_SLOTS];
+static COLORSLOT    ColorCache[COLOR_SLOTS];
+static WORD         wPalGen = 1;
+
+/* Invalidate everything. Called when the palette changes. */
+void ObjCacheFlush( void )
+{
+    /* Generation zero marks unused slots; skip it on wraparound. */
+    if( !++wPalGen ) {
+        _fmemset( PenCache, 0, sizeof( PenCache ) );
+        _fmemset( BrushCache, 0, sizeof( BrushCache ) );
+        _fmemset( ColorCache, 0, sizeof( ColorCache ) );
+        wPalGen = 1;
+    }
+}
+
+/* Describe the destination format, or return zero if objects realized
+ * for it can't be cached (DIB sections have their own color tables).
+ */
+static WORD ObjFormat( LPDIBENGINE lpDev )
+{
+    if( !lpDev || lpDev->deType != TYPE_DIBENG || (lpDev->deFlags & SELECTEDDIB) )
+        return( 0 );
+    return( lpDev->deBitsPixel | (lpDev->deFlags & FIVE6FIVE) << 8 );
+}
+
+static WORD ObjHash( DWORD dwColor, WORD wStyle, WORD wSlots )
+{
+    WORD    wHash;
+
+    wHash = (WORD)dwColor ^ (WORD)(dwColor >> 13) ^ (WORD)(dwColor >> 19) ^ wStyle;
+    return( (wHash ^ (wHash >> 5)) & (wSlots - 1) );
+}
+
+/* Size of a realized brush for the given depth. */
+static WORD BrushSize( WORD wBpp )
+{
+    switch( wBpp ) {
+    case 1:  return( sizeof( DIB_Brush1 ) );
+    case 4:  return( sizeof( DIB_Brush4 ) );
+    case 8:  return( sizeof( DIB_Brush8 ) );
+    case 16: return( sizeof( DIB_Brush16 ) );
+    case 24: return( sizeof( DIB_Brush24 ) );
+    case 32: return( sizeof( DIB_Brush32 ) );
+    default: return( 0 );
+    }
+}
+
+/* Realize pens and solid brushes through the cache; everything else,
+ * including size queries and deletions, goes straight to the DIB Engine.
+ */
+DWORD WINAPI __loadds RealizeObject( LPDIBENGINE lpDestDev, int wStyle, LPVOID lpInObj,
+                                     LPVOID lpOutObj, LPTEXTXFORM lpTextXForm )
+{
+    WORD        wFormat = ObjFormat( lpDestDev );
+    OBJKEY      *pKey;
+    LPVOID      lpCached;
+    WORD        wSize;
+    DWORD       dwColor;
+    WORD        wObjStyle;
+    DWORD       dwRet;
+
+    if( !wFormat || !lpInObj || !lpOutObj )
+        goto punt;
+
+    if( wStyle == OBJ_PEN ) {
+        LPLOGPEN    lpPen = lpInObj;
+        PENSLOT     *pSlot;
+
+        dwColor   = lpPen->lopnColor;
+        wObjStyle = lpPen->lopnStyle;
+        pSlot     = &PenCache[ObjHash( dwColor, wObjStyle, PEN_SLOTS )];
+        pKey      = &pSlot->Key;
+        lpCached  = &pSlot->Pen;
+        wSize     = sizeof( DIB_Pen );
+    } else if( wStyle == OBJ_BRUSH ) {
+        LPLOGBRUSH  lpBrush = lpInObj;
+        BRUSHSLOT   *pSlot;
+
+        if( lpBrush->lbStyle != BS_SOLID )
+            goto punt;
+        dwColor   = lpBrush->lbColor;
+        wObjStyle = BS_SOLID;
+        pSlot     = &BrushCache[ObjHash( dwColor, wObjStyle, BRUSH_SLOTS )];
+        pKey      = &pSlot->Key;
+        lpCached  = &pSlot->Brush;
+        wSize     = BrushSize( lpDestDev->deBitsPixel );
+        if( !wSize )
+            goto punt;
+    } else {
+        goto punt;
+    }
+
+    if( pKey->wGen == wPalGen && pKey->dwColor == dwColor && pKey->wStyle == wObjStyle && pKey->wFormat == wFormat ) {
+        _fmemcpy( lpOutObj, lpCached, wSize );
+        return( pKey->dwRet );
+    }
+
+    dwRet = DIB_RealizeObjectExt( lpDestDev, wStyle, lpInObj, lpOutObj, lpTextXForm, lpDriverPDevice );
+    if( !dwRet )
+        return( dwRet );
+
+    /* Only pure solid brushes; dithered ones depend on the brush origin. */
+    if( wStyle == OBJ_BRUSH && !(((DIB_Brush8 FAR *)lpOutObj)->dp8BrushFlags & COLORSOLID) )
+        return( dwRet );
+
+    _fmemcpy( lpCached, lpOutObj, wSize );
+    pKey->dwColor = dwColor;
+    pKey->wStyle  = wObjStyle;
+    pKey->wFormat = wFormat;
+    pKey->wGen    = wPalGen;
+    pKey->dwRet   = dwRet;
+    return( dwRet );
+
+punt:
+    return( DIB_RealizeObjectExt( lpDestDev, wStyle, lpInObj, lpOutObj, lpTextXForm, lpDriverPDevice ) );
+}
+
+/* Map logical to physical colors through the cache. The reverse mapping
+ * (no lpPColor) is passed to the DIB Engine.
+ */
+DWORD WINAPI __loadds ColorInfo( LPDIBENGINE lpDestDev, DWORD dwColorIn, LPDWORD lpPColor )
+{
+    WORD        wFormat = ObjFormat( lpDestDev );
+    COLORSLOT   *pSlot;
+    DWORD       dwRet;
+
+    if( !wFormat || !lpPColor )
+        return( DIB_ColorInfo( lpDestDev, dwColorIn, lpPColor ) );
+
+    pSlot = &ColorCache[ObjHash( dwColorIn, 0, COLOR_SLOTS )];
+    if( pSlot->wGen == wPalGen && pSlot->dwColor == dwColorIn && pSlot->wFormat == wFormat ) {
+        *lpPColor = pSlot->dwPhys;
+        return( pSlot->dwRet );
+    }
+
+    dwRet = DIB_ColorInfo( lpDestDev, dwColorIn, lpPColor );
+    pSlot->dwColor = dwColorIn;
+    pSlot->wFormat = wFormat;
+    pSlot->wGen    = wPalGen;
+    pSlot->dwPhys  = *lpPColor;
+    pSlot->dwRet   = dwRet;
+    return( dwRet );
+}
@@ -0,0 +1,479 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* Output() fast paths. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+/* How the current Output call fills spans. */
+#define OUT_NONE    0   /* Can't do it, pass to the DIB Engine. */
+#define OUT_PAT     1   /* Brush fill, see pattern.c. */
+#define OUT_FILL    2   /* Solid fill with dwOutColor. */
+#define OUT_XOR     3   /* XOR with dwOutColor. */
+
+static WORD         wOutMode;
+static DWORD        dwOutColor;
+static LPDIBENGINE  lpOutDev;
+
+/* Figure out how to fill with the given brush and ROP2. Solid colors,
+ * inversion, and XOR are done directly; COPYPEN can use any brush.
+ */
+static WORD OutSelect( LPDIBENGINE lpDev, LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode )
+{
+    DIB_Brush8 FAR  *lpBrush = lpPBrush;
+
+    lpOutDev = lpDev;
+    switch( lpDrawMode->Rop2 ) {
+    case R2_BLACK:
+        dwOutColor = 0;
+        return( Kern.pfnFill ? OUT_FILL : OUT_NONE );
+    case R2_WHITE:
+        dwOutColor = 0xFFFFFFFF;
+        return( Kern.pfnFill ? OUT_FILL : OUT_NONE );
+    case R2_NOT:
+        dwOutColor = 0xFFFFFFFF;
+        return( Kern.pfnXor ? OUT_XOR : OUT_NONE );
+    case R2_NOP:
+        return( OUT_NONE );
+    case R2_COPYPEN:
+        return( PatSelect( lpDev, lpPBrush, lpDrawMode ) ? OUT_PAT : OUT_NONE );
+    case R2_XORPEN:
+        if( !lpBrush || !(lpBrush->dp8BrushFlags & COLORSOLID) || lpBrush->dp8BrushStyle == BS_HOLLOW
+         || lpBrush->dp8BrushBpp != lpDev->deBitsPixel )
+            return( OUT_NONE );
+        dwOutColor = *(DWORD FAR *)lpBrush->dp8BrushBits;
+        return( Kern.pfnXor ? OUT_XOR : OUT_NONE );
+    default:
+        return( OUT_NONE );
+    }
+}
+
+/* Fill a rectangle as set up by OutSelect. */
+static void OutRect( WORD wX, WORD wY, WORD wXext, WORD wYext )
+{
+    if( wOutMode == OUT_PAT ) {
+        PatFillRect( wX, wY, wXext, wYext );
+        return;
+    }
+    KernJob.wDstSel   = lpOutDev->deBitsSelector;
+    KernJob.lDstPitch = lpOutDev->deDeltaScan;
+    KernJob.dwDstOfs  = lpOutDev->deBitsOffset + (long)wY * lpOutDev->deDeltaScan
+                      + (DWORD)wX * (lpOutDev->deBitsPixel >> 3);
+    KernJob.wWidth    = wXext;
+    KernJob.wHeight   = wYext;
+    KernJob.dwColor   = dwOutColor;
+    if( wOutMode == OUT_FILL )
+        Kern.pfnFill();
+    else
+        Kern.pfnXor();
+}
+
+/* Clip a rectangle, given with exclusive right/bottom coordinates.
+ * Returns zero if nothing is left.
+ */
+static int OutClip( RECT *pRect, LPRECT lpClipRect )
+{
+    if( lpClipRect ) {
+        if( pRect->left < lpClipRect->left )
+            pRect->left = lpClipRect->left;
+        if( pRect->top < lpClipRect->top )
+            pRect->top = lpClipRect->top;
+        if( pRect->right > lpClipRect->right )
+            pRect->right = lpClipRect->right;
+        if( pRect->bottom > lpClipRect->bottom )
+            pRect->bottom = lpClipRect->bottom;
+    }
+    return( pRect->left < pRect->right && pRect->top < pRect->bottom );
+}
+
+/* Draw a batch of scanline segments. The first point holds the y
+ * coordinate; each of the others holds the left (xcoord) and exclusive
+ * right (ycoord) edges of one segment. The cursor is excluded only once
+ * for the whole batch.
+ */
+static void OutScanlines( WORD wCount, LPPOINT lpPoints, LPRECT lpClipRect )
+{
+    RECT    rc;
+    int     y = lpPoints[0].ycoord;
+    int     xMin = 0x7FFF;
+    int     xMax = -0x7FFF;
+    WORD    i;
+
+    if( lpClipRect && (y < lpClipRect->top || y >= lpClipRect->bottom) )
+        return;
+
+    /* Find the extent of the batch first. */
+    for( i = 1; i < wCount; ++i ) {
+        if( lpPoints[i].xcoord < xMin )
+            xMin = lpPoints[i].xcoord;
+        if( lpPoints[i].ycoord > xMax )
+            xMax = lpPoints[i].ycoord;
+    }
+    if( lpClipRect ) {
+        if( xMin < lpClipRect->left )
+            xMin = lpClipRect->left;
+        if( xMax > lpClipRect->right )
+            xMax = lpClipRect->right;
+    }
+    if( xMin >= xMax )
+        return;
+
+    ((BEGINACCESSPROC)lpOutDev->deBeginAccess)( lpOutDev, xMin, y, xMax - 1, y, CURSOREXCLUDE );
+    for( i = 1; i < wCount; ++i ) {
+        rc.left   = lpPoints[i].xcoord;
+        rc.right  = lpPoints[i].ycoord;
+        rc.top    = y;
+        rc.bottom = y + 1;
+        if( OutClip( &rc, lpClipRect ) )
+            OutRect( rc.left, y, rc.right - rc.left, 1 );
+    }
+    ((ENDACCESSPROC)lpOutDev->deEndAccess)( lpOutDev, CURSOREXCLUDE );
+}
+
+/* Fill the interior of a rectangle drawn without a border. The right
+ * and bottom edges are exclusive.
+ */
+static void OutRectangle( LPPOINT lpPoints, LPRECT lpClipRect )
+{
+    RECT    rc;
+
+    rc.left   = lpPoints[0].xcoord;
+    rc.top    = lpPoints[0].ycoord;
+    rc.right  = lpPoints[1].xcoord;
+    rc.bottom = lpPoints[1].ycoord;
+    if( !OutClip( &rc, lpClipRect ) )
+        return;
+
+    ((BEGINACCESSPROC)lpOutDev->deBeginAccess)( lpOutDev, rc.left, rc.top, rc.right - 1,
+                                                rc.bottom - 1, CURSOREXCLUDE );
+    OutRect( rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top );
+    ((ENDACCESSPROC)lpOutDev->deEndAccess)( lpOutDev, CURSOREXCLUDE );
+}
+
+/* Line style masks, one bit per pixel, MSB first. Indexed by LS_xxx. */
+static const WORD StyleMask[] = {
+    0xFFFF,     /* LS_SOLID */
+    0xFFF0,     /* LS_DASHED */
+    0xCCCC,     /* LS_DOTTED */
+    0xFF18,     /* LS_DOTDASHED */
+    0xFCCC      /* LS_DASHDOTDOT */
+};
+
+/* Longest line segment handled; keeps the error terms within a long. */
+#define LINE_MAX_DELTA  0x3FFF
+
+static WORD     wLineStyle;     /* Current style mask, rotated as drawn. */
+static WORD     wLineOp;        /* LOP_xxx flags. */
+static DWORD    dwLineColor;
+static DWORD    dwLineBkColor;
+static RECT     rcLineClip;     /* Exclusive right/bottom. */
+
+/* Set up line drawing with the given pen and ROP2. Returns zero if
+ * the DIB Engine has to do it.
+ */
+static int LineSelect( LPDIBENGINE lpDev, DIB_Pen FAR *lpPen, LPDRAWMODE lpDrawMode )
+{
+    if( !Kern.pfnLine || !lpPen || lpPen->dpPenStyle > LS_DASHDOTDOT || lpPen->dpPenBpp != lpDev->deBitsPixel )
+        return( 0 );
+
+    lpOutDev      = lpDev;
+    wLineStyle    = StyleMask[lpPen->dpPenStyle];
+    dwLineColor   = lpPen->dpPenColor;
+    dwLineBkColor = lpDrawMode->LbkColor;
+    wLineOp       = 0;
+    switch( lpDrawMode->Rop2 ) {
+    case R2_COPYPEN:
+        break;
+    case R2_XORPEN:
+        wLineOp = LOP_XOR;
+        break;
+    case R2_NOT:
+        wLineOp = LOP_XOR;
+        dwLineColor = dwLineBkColor = 0xFFFFFFFF;
+        break;
+    case R2_BLACK:
+        dwLineColor = dwLineBkColor = 0;
+        break;
+    case R2_WHITE:
+        dwLineColor = dwLineBkColor = 0xFFFFFFFF;
+        break;
+    default:
+        return( 0 );
+    }
+    if( wLineStyle != 0xFFFF && lpDrawMode->bkMode != TRANSPARENT )
+        wLineOp |= LOP_OPAQUE;
+    return( 1 );
+}
+
+/* Advance the line style by the given number of pixels. */
+static void LineStyleSkip( WORD wPixels )
+{
+    wPixels &= 15;
+    if( wPixels )
+        wLineStyle = (wLineStyle << wPixels) | (wLineStyle >> (16 - wPixels));
+}
+
+/* Index of the first pixel along a line whose minor axis coordinate
+ * has moved by at least 'lSteps'. Pixel k is at minor offset
+ * (2 * k * lMinor + lMajor) / (2 * lMajor), which is what the kernel's
+ * error term tracks.
+ */
+static long LineFirst( long lSteps, long lMajor, long lMinor )
+{
+    if( lSteps <= 0 )
+        return( 0 );
+    return( ((2 * lSteps - 1) * lMajor + 2 * lMinor - 1) / (2 * lMinor) );
+}
+
+/* Clip a line to a range along its minor axis. Narrows the pixel
+ * index range [*plFirst, *plEnd).
+ */
+static void LineClipMinor( int n0, int sn, int nLo, int nHi, long lMajor, long lMinor,
+                           long *plFirst, long *plEnd )
+{
+    long    lLo, lHi;   /* Range of minor steps which stays inside. */
+    long    l;
+
+    if( sn > 0 ) {
+        lLo = nLo - n0;
+        lHi = nHi - 1 - n0;
+    } else {
+        lLo = n0 - (nHi - 1);
+        lHi = n0 - nLo;
+    }
+    if( !lMinor ) {
+        if( lLo > 0 || lHi < 0 )
+            *plEnd = *plFirst;
+        return;
+    }
+    l = LineFirst( lLo, lMajor, lMinor );
+    if( l > *plFirst )
+        *plFirst = l;
+    l = LineFirst( lHi + 1, lMajor, lMinor );
+    if( l < *plEnd )
+        *plEnd = l;
+}
+
+/* Draw a line from (x0,y0) up to but not including (x1,y1). */
+static void LineSegment( int x0, int y0, int x1, int y1 )
+{
+    LPDIBENGINE lpDev = lpOutDev;
+    WORD        wPixBytes = lpDev->deBitsPixel >> 3;
+    long        lPitch = lpDev->deDeltaScan;
+    int         sx = 1, sy = 1;
+    long        dx = (long)x1 - x0;
+    long        dy = (long)y1 - y0;
+    long        lMajor, lMinor, lFirst, lEnd, l, r;
+    long        lMajStep, lMinStep;
+    int         xp, yp;
+
+    if( dx < 0 ) {
+        dx = -dx;
+        sx = -1;
+    }
+    if( dy < 0 ) {
+        dy = -dy;
+        sy = -1;
+    }
+
+    /* Clip along both axes. */
+    lFirst = 0;
+    if( dx >= dy ) {
+        lMajor = dx;
+        lMinor = dy;
+        lEnd   = dx;
+        if( sx > 0 ) {
+            l = (long)rcLineClip.left - x0;
+            if( l > lFirst )
+                lFirst = l;
+            l = (long)rcLineClip.right - x0;
+        } else {
+            l = (long)x0 - (rcLineClip.right - 1);
+            if( l > lFirst )
+                lFirst = l;
+            l = (long)x0 - rcLineClip.left + 1;
+        }
+        if( l < lEnd )
+            lEnd = l;
+        LineClipMinor( y0, sy, rcLineClip.top, rcLineClip.bottom, lMajor, lMinor, &lFirst, &lEnd );
+    } else {
+        lMajor = dy;
+        lMinor = dx;
+        lEnd   = dy;
+        if( sy > 0 ) {
+            l = (long)rcLineClip.top - y0;
+            if( l > lFirst )
+                lFirst = l;
+            l = (long)rcLineClip.bottom - y0;
+        } else {
+            l = (long)y0 - (rcLineClip.bottom - 1);
+            if( l > lFirst )
+                lFirst = l;
+            l = (long)y0 - rcLineClip.top + 1;
+        }
+        if( l < lEnd )
+            lEnd = l;
+        LineClipMinor( x0, sx, rcLineClip.left, rcLineClip.right, lMajor, lMinor, &lFirst, &lEnd );
+    }
+    if( lFirst >= lEnd ) {
+        LineStyleSkip( (WORD)lMajor );
+        return;
+    }
+
+    /* Position and error term of the first visible pixel. */
+    r = lMajor + 2 * lFirst * lMinor;
+    l = r / (2 * lMajor);
+    r %= 2 * lMajor;
+    if( dx >= dy ) {
+        xp = x0 + (int)lFirst * sx;
+        yp = y0 + (int)l * sy;
+        lMajStep = (long)sx * wPixBytes;
+        lMinStep = sy * lPitch;
+    } else {
+        xp = x0 + (int)l * sx;
+        yp = y0 + (int)lFirst * sy;
+        lMajStep = sy * lPitch;
+        lMinStep = (long)sx * wPixBytes;
+    }
+    LineStyleSkip( (WORD)lFirst );
+
+    if( !lMinor && wLineStyle == 0xFFFF ) {
+        /* Solid horizontal or vertical line, use the fill kernels. */
+        WORD    wLen = (WORD)(lEnd - lFirst);
+
+        wOutMode   = wLineOp & LOP_XOR ? OUT_XOR : OUT_FILL;
+        dwOutColor = dwLineColor;
+        if( dy == 0 )
+            OutRect( sx > 0 ? xp : xp - wLen + 1, yp, wLen, 1 );
+        else
+            OutRect( xp, sy > 0 ? yp : yp - wLen + 1, 1, wLen );
+    } else {
+        KernJob.wDstSel   = lpDev->deBitsSelector;
+        KernJob.dwDstOfs  = lpDev->deBitsOffset + (long)yp * lPitch + (long)xp * wPixBytes;
+        KernJob.lDstPitch = lMajStep;
+        KernJob.lSrcPitch = lMinStep;
+        KernJob.wWidth    = (WORD)(lEnd - lFirst);
+        KernJob.dwColor   = dwLineColor;
+        KernJob.dwBgColor = dwLineBkColor;
+        KernJob.lErr      = r;
+        KernJob.lErrInc   = 2 * lMinor;
+        KernJob.lErrDec   = 2 * lMajor;
+        KernJob.wStyle    = wLineStyle;
+        KernJob.wLineOp   = wLineOp;
+        Kern.pfnLine();
+    }
+    LineStyleSkip( (WORD)(lMajor - lFirst) );
+}
+
+/* Draw a polyline. The last point is not drawn. The style continues
+ * from one segment to the next. Returns zero if any segment is too
+ * long to be handled.
+ */
+static int OutPolyline( WORD wCount, LPPOINT lpPoints, LPRECT lpClipRect )
+{
+    int     xMin, xMax, yMin, yMax;
+    WORD    i;
+
+    xMin = xMax = lpPoints[0].xcoord;
+    yMin = yMax = lpPoints[0].ycoord;
+    for( i = 1; i < wCount; ++i ) {
+        int     x = lpPoints[i].xcoord;
+        int     y = lpPoints[i].ycoord;
+        long    dx = (long)x - lpPoints[i - 1].xcoord;
+        long    dy = (long)y - lpPoints[i - 1].ycoord;
+
+        if( dx < -LINE_MAX_DELTA || dx > LINE_MAX_DELTA || dy < -LINE_MAX_DELTA || dy > LINE_MAX_DELTA )
+            return( 0 );
+        if( x < xMin ) xMin = x;
+        if( x > xMax ) xMax = x;
+        if( y < yMin ) yMin = y;
+        if( y > yMax ) yMax = y;
+    }
+
+    /* Clip to the screen and the clip rectangle. */
+    rcLineClip.left   = 0;
+    rcLineClip.top    = 0;
+    rcLineClip.right  = lpOutDev->deWidth;
+    rcLineClip.bottom = lpOutDev->deHeight;
+    if( lpClipRect && !OutClip( &rcLineClip, lpClipRect ) )
+        return( 1 );
+
+    /* Exclude the cursor from the visible part of the bounding box. */
+    if( xMin < rcLineClip.left )        xMin = rcLineClip.left;
+    if( yMin < rcLineClip.top )         yMin = rcLineClip.top;
+    if( xMax > rcLineClip.right - 1 )   xMax = rcLineClip.right - 1;
+    if( yMax > rcLineClip.bottom - 1 )  yMax = rcLineClip.bottom - 1;
+    if( xMin > xMax || yMin > yMax )
+        return( 1 );
+
+    ((BEGINACCESSPROC)lpOutDev->deBeginAccess)( lpOutDev, xMin, yMin, xMax, yMax, CURSOREXCLUDE );
+    for( i = 1; i < wCount; ++i )
+        LineSegment( lpPoints[i - 1].xcoord, lpPoints[i - 1].ycoord,
+                     lpPoints[i].xcoord, lpPoints[i].ycoord );
+    ((ENDACCESSPROC)lpOutDev->deEndAccess)( lpOutDev, CURSOREXCLUDE );
+    return( 1 );
+}
+
+/* Intercept Output for the screen. Filled scanlines, borderless
+ * rectangles, and cosmetic polylines are handled here; everything else
+ * goes to the DIB Engine.
+ */
+WORD WINAPI __loadds Output( LPDIBENGINE lpDestDev, WORD wStyle, WORD wCount, LPPOINT lpPoints,
+                             LPPPEN lpPPen, LPPBRUSH lpPBrush, LPDRAWMODE lpDrawMode, LPRECT lpClipRect )
+{
+    DIB_Pen FAR *lpPen = lpPPen;
+    WORD        wFlags = lpDestDev->deFlags;
+
+    if( (wFlags & VRAM) && !(wFlags & BUSY) && lpDestDev->deBitsPixel >= 8 && lpDrawMode ) {
+        switch( wStyle ) {
+        case OS_SCANLINES:
+            if( wCount < 2 || !lpPBrush )
+                break;
+            wOutMode = OutSelect( lpDestDev, lpPBrush, lpDrawMode );
+            if( wOutMode == OUT_NONE )
+                break;
+            OutScanlines( wCount, lpPoints, lpClipRect );
+            return( 1 );
+        case OS_RECTANGLE:
+            if( wCount != 2 || !lpPBrush || (lpPen && lpPen->dpPenStyle != LS_NOLINE) )
+                break;
+            wOutMode = OutSelect( lpDestDev, lpPBrush, lpDrawMode );
+            if( wOutMode == OUT_NONE )
+                break;
+            OutRectangle( lpPoints, lpClipRect );
+            return( 1 );
+        case OS_POLYLINE:
+            if( wCount < 2 || !LineSelect( lpDestDev, lpPen, lpDrawMode ) )
+                break;
+            if( OutPolyline( wCount, lpPoints, lpClipRect ) )
+                return( 1 );
+            break;
+        }
+    }
+    return( DIB_Output( lpDestDev, wStyle, wCount, lpPoints, lpPPen, lpPBrush, lpDrawMode, lpClipRect ) );
+}
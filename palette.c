@@ -57,9 +57,66 @@ UINT WINAPI __loadds SetPalette( UINT wStartIndex, UINT wNumEntries, LPVOID lpPa
 {
     /* Let the DIB engine do what it can. */
     DIB_SetPaletteExt( wStartIndex, wNumEntries, lpPalette, lpDriverPDevice );
+    ObjCacheFlush();
+    InvMapInvalidate( wStartIndex, wNumEntries );
 
     if( !(lpDriverPDevice->deFlags & BUSY) )
         SetRAMDAC( wStartIndex, wNumEntries, lpColorTable );
 
     return( 0 );
 }
+
+/* Realized objects depend on the translation as well. */
+VOID WINAPI __loadds SetPaletteTranslate( LPWORD lpIndexes )
+{
+    DIB_SetPaletteTranslateExt( lpIndexes, lpDriverPDevice );
+    ObjCacheFlush();
+}
+
+/* Remap screen pixels after a palette change, e.g. when a background
+ * application realizes its palette. The translate table is collapsed to
+ * bytes first; if it turns out to be the identity, nothing on the screen
+ * can change and the call costs nothing.
+ */
+VOID WINAPI __loadds UpdateColors( WORD wStartX, WORD wStartY, WORD wExtX, WORD wExtY, LPWORD lpTranslate )
+{
+    static BYTE XlatTab[256];
+    LPBYTE      lpTab = XlatTab;
+    LPDIBENGINE lpDev = lpDriverPDevice;
+    WORD        i;
+    WORD        wChanged = 0;
+
+    if( !(lpDev->deFlags & VRAM) || (lpDev->deFlags & BUSY) || lpDev->deBitsPixel != 8 ) {
+        DIB_UpdateColorsExt( wStartX, wStartY, wExtX, wExtY, lpTranslate, lpDriverPDevice );
+        return;
+    }
+
+    for( i = 0; i < 256; ++i ) {
+        XlatTab[i] = (BYTE)lpTranslate[i];
+        wChanged |= XlatTab[i] ^ i;
+    }
+    if( !wChanged )
+        return;
+
+    if( wStartX >= lpDev->deWidth || wStartY >= lpDev->deHeight )
+        return;
+    if( wExtX > lpDev->deWidth - wStartX )
+        wExtX = lpDev->deWidth - wStartX;
+    if( wExtY > lpDev->deHeight - wStartY )
+        wExtY = lpDev->deHeight - wStartY;
+    if( !wExtX || !wExtY )
+        return;
+
+    KernJob.wDstSel   = lpDev->deBitsSelector;
+    KernJob.dwDstOfs  = lpDev->deBitsOffset + (DWORD)wStartY * lpDev->deDeltaScan + wStartX;
+    KernJob.lDstPitch = lpDev->deDeltaScan;
+    KernJob.wSrcSel   = (__segment)lpTab;
+    KernJob.dwSrcOfs  = (WORD)(DWORD)lpTab;
+    KernJob.wWidth    = wExtX;
+    KernJob.wHeight   = wExtY;
+
+    ((BEGINACCESSPROC)lpDev->deBeginAccess)( lpDev, wStartX, wStartY, wStartX + wExtX - 1,
+                                             wStartY + wExtY - 1, CURSOREXCLUDE );
+    KernXlat8();
+    ((ENDACCESSPROC)lpDev->deEndAccess)( lpDev, CURSOREXCLUDE );
+}
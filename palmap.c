@@ -0,0 +1,186 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* Inverse colormap for palettized 8bpp modes. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+#include <string.h>
+
+/* The map has one byte for every 5-5-5 RGB value, holding the index of
+ * the closest palette entry. It is too big for DGROUP and lives in its
+ * own segment. It is only updated when needed, and only the entries
+ * changed by SetPalette are searched for then: cells whose entry was
+ * changed are searched from scratch, and all others are only compared
+ * against the changed entries. Distances are computed with 6-bit color
+ * components so that they fit in a WORD.
+ */
+
+#define INVMAP_SIZE     32768U
+#define INVMAP_PARTIAL  64      /* More changed entries than this, rebuild. */
+
+static WORD     wInvSel;                /* Map selector, zero if none. */
+static BYTE     bInvFull = 1;           /* Rebuild the whole map. */
+static BYTE     InvDirty[256 / 8];      /* Entries changed since the last update. */
+static BYTE     PalR[256];              /* 6-bit copies of the palette. */
+static BYTE     PalG[256];
+static BYTE     PalB[256];
+static BYTE     DirtyList[256];
+static WORD     PartRG[256];            /* Red + green distance of each entry. */
+
+/* Note palette entries which have changed. */
+void InvMapInvalidate( WORD wStart, WORD wCount )
+{
+    while( wCount-- && wStart < 256 ) {
+        InvDirty[wStart >> 3] |= 1 << (wStart & 7);
+        ++wStart;
+    }
+}
+
+/* Rebuild the entire map. */
+static void InvMapBuild( BYTE __far *lpMap )
+{
+    WORD    r, g, b, i;
+    WORD    wBest, wDist, wMin;
+    int     d;
+
+    for( r = 0; r < 32; ++r ) {
+        for( g = 0; g < 32; ++g ) {
+            for( i = 0; i < 256; ++i ) {
+                d = (int)(r * 2 + 1) - PalR[i];
+                wDist = d * d;
+                d = (int)(g * 2 + 1) - PalG[i];
+                PartRG[i] = wDist + d * d;
+            }
+            for( b = 0; b < 32; ++b ) {
+                wMin  = 0xFFFF;
+                wBest = 0;
+                for( i = 0; i < 256; ++i ) {
+                    d = (int)(b * 2 + 1) - PalB[i];
+                    wDist = PartRG[i] + d * d;
+                    if( wDist < wMin ) {
+                        wMin  = wDist;
+                        wBest = i;
+                        if( !wDist )
+                            break;
+                    }
+                }
+                *lpMap++ = wBest;
+            }
+        }
+    }
+}
+
+/* Distance of a map cell's center from palette entry i. */
+static WORD InvDist( WORD r, WORD g, WORD b, WORD i )
+{
+    int     dr = (int)(r * 2 + 1) - PalR[i];
+    int     dg = (int)(g * 2 + 1) - PalG[i];
+    int     db = (int)(b * 2 + 1) - PalB[i];
+
+    return( dr * dr + dg * dg + db * db );
+}
+
+/* Update the map for the entries in DirtyList. */
+static void InvMapPartial( BYTE __far *lpMap, WORD wDirty )
+{
+    WORD    r, g, b, i;
+    WORD    wCur, wDist, wMin;
+
+    for( r = 0; r < 32; ++r ) {
+        for( g = 0; g < 32; ++g ) {
+            for( b = 0; b < 32; ++b, ++lpMap ) {
+                wCur = *lpMap;
+                if( InvDirty[wCur >> 3] & (1 << (wCur & 7)) ) {
+                    /* The old closest entry changed, search everything. */
+                    wMin = 0xFFFF;
+                    for( i = 0; i < 256; ++i ) {
+                        wDist = InvDist( r, g, b, i );
+                        if( wDist < wMin ) {
+                            wMin = wDist;
+                            wCur = i;
+                        }
+                    }
+                } else {
+                    wMin = InvDist( r, g, b, wCur );
+                    for( i = 0; i < wDirty; ++i ) {
+                        wDist = InvDist( r, g, b, DirtyList[i] );
+                        if( wDist < wMin ) {
+                            wMin = wDist;
+                            wCur = DirtyList[i];
+                        }
+                    }
+                }
+                *lpMap = wCur;
+            }
+        }
+    }
+}
+
+/* Bring the map up to date with the current palette. Returns the map
+ * selector, or zero if there is no map.
+ */
+WORD InvMapUpdate( void )
+{
+    BYTE __far  *lpMap;
+    HGLOBAL     hMem;
+    WORD        wDirty = 0;
+    WORD        i;
+
+    if( !lpColorTable )
+        return( 0 );
+
+    if( !wInvSel ) {
+        hMem = GlobalAlloc( GMEM_FIXED | GMEM_SHARE, INVMAP_SIZE );
+        if( !hMem )
+            return( 0 );
+        wInvSel  = (__segment)GlobalLock( hMem );
+        bInvFull = 1;
+    }
+
+    for( i = 0; i < 256; ++i ) {
+        if( bInvFull || (InvDirty[i >> 3] & (1 << (i & 7))) ) {
+            PalR[i] = lpColorTable[i].rgbRed >> 2;
+            PalG[i] = lpColorTable[i].rgbGreen >> 2;
+            PalB[i] = lpColorTable[i].rgbBlue >> 2;
+            DirtyList[wDirty++] = i;
+        }
+    }
+    if( !wDirty )
+        return( wInvSel );
+
+    dbg_printf( "InvMapUpdate: %u entries changed\n", wDirty );
+    lpMap = wInvSel :> 0;
+    if( bInvFull || wDirty > INVMAP_PARTIAL )
+        InvMapBuild( lpMap );
+    else
+        InvMapPartial( lpMap, wDirty );
+    memset( InvDirty, 0, sizeof( InvDirty ) );
+    bInvFull = 0;
+    return( wInvSel );
+}
@@ -0,0 +1,185 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* Pattern brush fills. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+/* Realized DIB Engine brushes share a common layout up to and including
+ * the start of the pattern bits; only the size of the bits differs. The
+ * 8bpp brush structure is used to access all of them.
+ *
+ * The brush bits are aligned to the screen, i.e. pixel (x,y) of a fill
+ * uses brush pixel (x & 7, y & 7). To avoid that calculation for every
+ * pixel, the rows are rotated once for the destination x so that each
+ * starts with the first pixel to be filled, and replicated to make
+ * whole dwords. The kernels then simply copy the rows.
+ */
+
+DWORD   PatRows[8][16];     /* Pattern rows, rotated for the destination. */
+
+static BYTE             PatMask[8];     /* Rotated hatch mask rows. */
+static LPDIBENGINE      lpPatDev;       /* Current destination. */
+static DIB_Brush8 FAR   *lpPatBrush;    /* Current brush. */
+static KERNPROC         pfnPatKern;     /* Kernel used for the fill. */
+static WORD             wPatRot;        /* Rotation of PatRows, or PAT_NOROT. */
+
+#define PAT_NOROT   0xFFFF
+
+/* Fill PatRows with the brush pattern, rotated such that the first byte
+ * of each row corresponds to destination pixel wX. Returns the length
+ * of the pattern in dwords. At 24bpp, the pattern is repeated twice so
+ * that the kernels can read groups of four pixels without wrapping.
+ */
+WORD PatBuild( DIB_Brush8 FAR *lpBrush, WORD wX, WORD wPixBytes )
+{
+    LPBYTE  lpBits = lpBrush->dp8BrushBits;
+    WORD    wRowBytes = wPixBytes * 8;
+    WORD    wLen;
+    WORD    wRow;
+    WORD    i;
+    BYTE    *pPat;
+
+    /* A solid color repeats every dword (every 3 dwords at 24bpp). */
+    if( lpBrush->dp8BrushFlags & COLORSOLID )
+        wLen = wPixBytes == 3 ? 12 : 4;
+    else
+        wLen = wRowBytes;
+
+    for( wRow = 0; wRow < 8; ++wRow ) {
+        pPat = (BYTE *)PatRows[wRow];
+        for( i = 0; i < wLen; ++i )
+            pPat[i] = lpBits[((wX + i / wPixBytes) & 7) * wPixBytes + i % wPixBytes];
+        if( wPixBytes == 3 ) {
+            for( ; i < 48; ++i )
+                pPat[i] = pPat[i - wLen];
+        }
+        lpBits += wRowBytes;
+    }
+    return( wLen / 4 );
+}
+
+/* Rotate the hatch mask for destination pixel wX. Set mask bits select
+ * the hatch lines, drawn in the foreground color; the MSB of each mask
+ * row is pixel 0 within the row.
+ */
+static void PatBuildMask( DIB_Brush8 FAR *lpBrush, WORD wX )
+{
+    WORD    wRot = wX & 7;
+    WORD    wRow;
+    BYTE    bMask;
+
+    for( wRow = 0; wRow < 8; ++wRow ) {
+        bMask = lpBrush->dp8BrushMask[wRow * 4];
+        PatMask[wRow] = (bMask << wRot) | (bMask >> (8 - wRot));
+    }
+}
+
+/* Prepare for filling with a brush. Returns zero if the brush can't
+ * be handled by the driver.
+ */
+int PatSelect( LPDIBENGINE lpDev, LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode )
+{
+    DIB_Brush8 FAR  *lpBrush = lpPBrush;
+
+    if( !lpBrush || lpDev->deBitsPixel < 8 || lpBrush->dp8BrushBpp != lpDev->deBitsPixel )
+        return( 0 );
+
+    switch( lpBrush->dp8BrushStyle ) {
+    case BS_HOLLOW:
+        return( 0 );
+    case BS_HATCHED:
+        if( lpDrawMode && lpDrawMode->bkMode == TRANSPARENT ) {
+            pfnPatKern = Kern.pfnHatch;
+            break;
+        }
+        /* Opaque hatches are just patterns. */
+    default:
+        pfnPatKern = (lpBrush->dp8BrushFlags & COLORSOLID) ? Kern.pfnFill : Kern.pfnPat;
+        break;
+    }
+
+    lpPatDev   = lpDev;
+    lpPatBrush = lpBrush;
+    wPatRot    = PAT_NOROT;
+    return( pfnPatKern != NULL );
+}
+
+/* Like PatSelect, but prepare for XORing the brush into the destination
+ * (PATINVERT). Transparent hatches are not supported.
+ */
+int PatSelectXor( LPDIBENGINE lpDev, LPBRUSH lpPBrush )
+{
+    DIB_Brush8 FAR  *lpBrush = lpPBrush;
+
+    if( !lpBrush || lpDev->deBitsPixel < 8 || lpBrush->dp8BrushBpp != lpDev->deBitsPixel
+     || lpBrush->dp8BrushStyle == BS_HOLLOW )
+        return( 0 );
+
+    pfnPatKern = (lpBrush->dp8BrushFlags & COLORSOLID) ? Kern.pfnXor : Kern.pfnPatXor;
+    lpPatDev   = lpDev;
+    lpPatBrush = lpBrush;
+    wPatRot    = PAT_NOROT;
+    return( pfnPatKern != NULL );
+}
+
+/* Fill a rectangle with the brush set up by PatSelect. The caller is
+ * responsible for clipping and cursor exclusion.
+ */
+void PatFillRect( WORD wX, WORD wY, WORD wXext, WORD wYext )
+{
+    WORD    wPixBytes = lpPatDev->deBitsPixel >> 3;
+    WORD    wRot = wX & 7;
+
+    if( !wXext || !wYext )
+        return;
+
+    /* Rotate the pattern if needed. Solid colors need it only once. */
+    if( pfnPatKern == Kern.pfnHatch ) {
+        if( wRot != wPatRot )
+            PatBuildMask( lpPatBrush, wX );
+        KernJob.dwColor = lpPatBrush->dp8FgColor;
+        KernJob.pPat    = (WORD)PatMask;
+    } else {
+        if( wPatRot == PAT_NOROT || (wRot != wPatRot && pfnPatKern != Kern.pfnFill && pfnPatKern != Kern.pfnXor) )
+            PatBuild( lpPatBrush, wX, wPixBytes );
+        KernJob.dwColor = PatRows[0][0];
+        KernJob.pPat    = (WORD)PatRows;
+    }
+    wPatRot = wRot;
+
+    KernJob.wDstSel   = lpPatDev->deBitsSelector;
+    KernJob.lDstPitch = lpPatDev->deDeltaScan;
+    KernJob.dwDstOfs  = lpPatDev->deBitsOffset + (long)wY * lpPatDev->deDeltaScan
+                      + (DWORD)wX * wPixBytes;
+    KernJob.wWidth    = wXext;
+    KernJob.wHeight   = wYext;
+    KernJob.wPatRow   = wY & 7;
+    KernJob.wPatStep  = 1;
+    pfnPatKern();
+}
@@ -0,0 +1,618 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+/* Compiled ROP3 BitBlt. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+/*
+ * In the tradition of the Windows 3.x display drivers, BitBlt is compiled.
+ * Every ternary raster operation is a bitwise function f(P,S,D), so it can
+ * be applied a dword at a time regardless of color depth as long as source
+ * and destination share the pixel format. Splitting on D, the function can
+ * always be written as
+ *
+ *     f = G0 ^ (D & G2)    where G0 = f(P,S,0) and G2 = f(P,S,0) ^ f(P,S,1)
+ *
+ * G0 and G2 are functions of two variables, each of which takes at most four
+ * instructions to compute. When G2 is zero, the destination is not read at
+ * all; when G0 and G2 do not depend on S or P, those are not fetched either.
+ * SRCCOPY thus turns into a load and a store, SRCINVERT into a load, an XOR
+ * with memory, and a store, and so on.
+ *
+ * The code is generated into a buffer in the code segment (see rop3run.asm)
+ * through a writable alias selector. The most recently used loops are kept
+ * in a small number of slots. The loops are keyed by ROP, pattern length
+ * (which depends on bpp and the brush type), and the number of trailing
+ * bytes in each scanline.
+ *
+ * SRCCOPY and PATCOPY are simply passed to the framebuffer kernels
+ * (see kernels.asm and pattern.c), which also handle overlapping copies
+ * to the right and transparent hatched brushes.
+ */
+
+/* Must match ROP3_CODE_SIZE in rop3run.asm. */
+#define ROP3_CODE_SIZE  5120
+#define ROP3_SLOTS      8
+#define ROP3_SLOT_SIZE  (ROP3_CODE_SIZE / ROP3_SLOTS)
+
+/* Job description used by Rop3Run. Must match the RJ_xxx offsets
+ * in rop3run.asm!
+ */
+typedef struct {
+    WORD    wEntry;         /* Compiled dword loop. */
+    WORD    wTailEntry;     /* Compiled trailing bytes, zero if none. */
+    WORD    wTailPat;       /* Offset of tail pattern within pattern row. */
+    WORD    wPatRow;        /* Current pattern row (0-7). */
+    WORD    wPatStep;       /* Pattern row step, 1 or -1. */
+    WORD    wDwords;        /* Full dwords per scanline. */
+    WORD    wRows;          /* Number of scanlines. */
+    WORD    wDstSel;        /* Destination selector. */
+    WORD    wSrcSel;        /* Source selector. */
+    DWORD   dwDstOfs;       /* Destination offset of first scanline. */
+    long    lDstDelta;      /* Destination scanline delta. */
+    DWORD   dwSrcOfs;       /* Source offset of first scanline. */
+    long    lSrcDelta;      /* Source scanline delta. */
+} ROP3JOB;
+
+/* Accessed from rop3run.asm. */
+ROP3JOB Rop3Job;
+
+/* Code buffer and scanline walker in rop3run.asm. */
+extern BYTE __based( __segname( "_TEXT" ) ) Rop3Code[ROP3_CODE_SIZE];
+extern void Rop3Run( void );
+
+/* A cache slot. The key is built by ROP3KEY. */
+typedef struct {
+    WORD    wKey;           /* Key of compiled code, zero if unused. */
+    WORD    wTailOfs;       /* Offset of tail code, zero if none. */
+    WORD    wLastUse;       /* For LRU replacement. */
+} ROP3SLOT;
+
+#define ROP3KEY( rop, patlen, tail )    (0x8000 | ((tail) << 12) | ((patlen) << 8) | (rop))
+
+static ROP3SLOT     Rop3Slots[ROP3_SLOTS];
+static WORD         wRop3Clock = 0;     /* LRU timestamp. */
+static WORD         wCodeAlias = 0;     /* Writable alias of code segment. */
+static BYTE __far   *lpCode;            /* Code segment through alias. */
+static WORD         wPc;                /* Current code offset. */
+static WORD         wPcLimit;           /* End of the current slot. */
+static BYTE         bOverflow;          /* Set if code didn't fit. */
+
+/* Decomposition of the current ROP, see above. */
+static BYTE         bG0, bG2;
+static BYTE         bUseS;
+
+/* Descriptions of the 16 functions of P and S, indexed by truth table
+ * (bit 0: P=0 S=0, bit 1: P=0 S=1, bit 2: P=1 S=0, bit 3: P=1 S=1).
+ * Each starts by loading P (or S if FN_LOAD_S is set) into a register.
+ */
+#define FN_LOAD_S       0x01    /* Load S instead of P. */
+#define FN_NOT_LOAD     0x02    /* Invert loaded value. */
+#define FN_AND          0x04    /* AND with the other operand. */
+#define FN_OR           0x08    /* OR with the other operand. */
+#define FN_XOR          0x0C    /* XOR with the other operand. */
+#define FN_OP_MASK      0x0C
+#define FN_NOT          0x10    /* Invert the result. */
+#define FN_ZERO         0x20    /* Constant zero. */
+#define FN_ONES         0x40    /* Constant all ones. */
+
+static const BYTE FnTab[16] = {
+    FN_ZERO,                                    /* 0: 0       */
+    FN_OR | FN_NOT,                             /* 1: ~(P|S)  */
+    FN_NOT_LOAD | FN_AND,                       /* 2: ~P&S    */
+    FN_NOT,                                     /* 3: ~P      */
+    FN_LOAD_S | FN_NOT_LOAD | FN_AND,           /* 4: P&~S    */
+    FN_LOAD_S | FN_NOT,                         /* 5: ~S      */
+    FN_XOR,                                     /* 6: P^S     */
+    FN_AND | FN_NOT,                            /* 7: ~(P&S)  */
+    FN_AND,                                     /* 8: P&S     */
+    FN_XOR | FN_NOT,                            /* 9: ~(P^S)  */
+    FN_LOAD_S,                                  /* A: S       */
+    FN_LOAD_S | FN_NOT_LOAD | FN_AND | FN_NOT,  /* B: ~P|S    */
+    0,                                          /* C: P       */
+    FN_NOT_LOAD | FN_AND | FN_NOT,              /* D: P|~S    */
+    FN_OR,                                      /* E: P|S     */
+    FN_ONES                                     /* F: 1       */
+};
+
+#define FN_S            0x0A    /* Truth table of plain S. */
+
+/* Does a function of P and S depend on S or P? */
+#define FN_USES_S( f )  (((f) ^ ((f) >> 1)) & 0x05)
+#define FN_USES_P( f )  (((f) ^ ((f) >> 2)) & 0x03)
+
+/* Registers as encoded in ModR/M bytes. The compiled code keeps the
+ * result in EAX, the masked destination in ECX, and the source in EDX.
+ */
+#define R_AX            0
+#define R_CX            1
+#define R_DX            2
+#define RM_SI           6
+#define RM_DI           7
+#define RM_BX           7       /* With 16-bit addressing. */
+
+/* Opcodes of the 32-bit forms; the 8-bit forms are one less. */
+#define OP_STORE        0x89
+#define OP_LOAD         0x8B
+#define OP_AND          0x23
+#define OP_OR           0x0B
+#define OP_XOR          0x33
+#define OP_NOT          0xF7
+
+#define PFX_OPSIZE      0x66
+#define PFX_ADRSIZE     0x67
+#define PFX_ES          0x26
+#define PFX_FS          0x64
+
+#define MODRM_REG( r, rm )      (0xC0 | ((r) << 3) | (rm))
+
+
+static void Emit( BYTE b )
+{
+    if( wPc < wPcLimit )
+        lpCode[wPc++] = b;
+    else
+        bOverflow = 1;
+}
+
+static void EmitWord( WORD w )
+{
+    Emit( (BYTE)w );
+    Emit( w >> 8 );
+}
+
+/* Emit an instruction with a register or [bx+disp8] operand.
+ * The bByte flag selects 8-bit instead of 32-bit operand size.
+ */
+static void EmitOp( BYTE bByte, BYTE bOp, BYTE bModRM )
+{
+    if( !bByte )
+        Emit( PFX_OPSIZE );
+    Emit( bOp - bByte );
+    Emit( bModRM );
+}
+
+/* Emit an instruction with a seg:[esi] or seg:[edi] memory operand. */
+static void EmitMem( BYTE bSeg, BYTE bByte, BYTE bOp, BYTE bReg, BYTE bRM )
+{
+    Emit( bSeg );
+    if( !bByte )
+        Emit( PFX_OPSIZE );
+    Emit( PFX_ADRSIZE );
+    Emit( bOp - bByte );
+    Emit( (bReg << 3) | bRM );
+}
+
+/* Emit 'op reg, S' or 'op reg, P'. The pattern is at [bx+bDisp]. */
+static void EmitOperand( BYTE bByte, BYTE bOp, BYTE bReg, BYTE bUsePat, BYTE bDisp )
+{
+    if( bUsePat ) {
+        EmitOp( bByte, bOp, 0x40 | (bReg << 3) | RM_BX );
+        Emit( bDisp );
+    } else {
+        EmitOp( bByte, bOp, MODRM_REG( bReg, R_DX ) );
+    }
+}
+
+/* Compute a function of P and S into a register. */
+static void EmitFn( BYTE bFn, BYTE bReg, BYTE bByte, BYTE bDisp )
+{
+    BYTE    bDesc = FnTab[bFn];
+    BYTE    bLoadS;
+
+    if( bDesc & FN_ZERO ) {
+        EmitOp( bByte, OP_XOR, MODRM_REG( bReg, bReg ) );
+    } else if( bDesc & FN_ONES ) {
+        if( bByte ) {
+            Emit( 0xB0 + bReg );                /* mov reg8, 0FFh */
+            Emit( 0xFF );
+        } else {
+            Emit( PFX_OPSIZE );                 /* or reg32, -1 */
+            Emit( 0x83 );
+            Emit( MODRM_REG( 1, bReg ) );
+            Emit( 0xFF );
+        }
+    } else {
+        bLoadS = bDesc & FN_LOAD_S;
+        EmitOperand( bByte, OP_LOAD, bReg, !bLoadS, bDisp );
+        if( bDesc & FN_NOT_LOAD )
+            EmitOp( bByte, OP_NOT, MODRM_REG( 2, bReg ) );
+        switch( bDesc & FN_OP_MASK ) {
+        case FN_AND:
+            EmitOperand( bByte, OP_AND, bReg, bLoadS, bDisp );
+            break;
+        case FN_OR:
+            EmitOperand( bByte, OP_OR, bReg, bLoadS, bDisp );
+            break;
+        case FN_XOR:
+            EmitOperand( bByte, OP_XOR, bReg, bLoadS, bDisp );
+            break;
+        }
+        if( bDesc & FN_NOT )
+            EmitOp( bByte, OP_NOT, MODRM_REG( 2, bReg ) );
+    }
+}
+
+/* Emit code for one dword (or byte), including pointer updates. */
+static void EmitPixelOp( BYTE bByte, BYTE bDisp )
+{
+    BYTE    bResult;
+
+    if( bUseS )
+        EmitMem( PFX_FS, bByte, OP_LOAD, R_DX, RM_SI );
+
+    if( !bG2 ) {
+        /* Destination not needed. */
+        if( bG0 == FN_S ) {
+            bResult = R_DX;
+        } else {
+            EmitFn( bG0, R_AX, bByte, bDisp );
+            bResult = R_AX;
+        }
+    } else {
+        if( bG2 == 0x0F ) {
+            EmitMem( PFX_ES, bByte, OP_LOAD, R_CX, RM_DI );
+        } else {
+            EmitFn( bG2, R_CX, bByte, bDisp );
+            EmitMem( PFX_ES, bByte, OP_AND, R_CX, RM_DI );
+        }
+        bResult = R_CX;
+        if( bG0 == 0x0F ) {
+            EmitOp( bByte, OP_NOT, MODRM_REG( 2, R_CX ) );
+        } else if( bG0 == FN_S ) {
+            EmitOp( bByte, OP_XOR, MODRM_REG( R_CX, R_DX ) );
+        } else if( bG0 ) {
+            EmitFn( bG0, R_AX, bByte, bDisp );
+            EmitOp( bByte, OP_XOR, MODRM_REG( R_AX, R_CX ) );
+            bResult = R_AX;
+        }
+    }
+    EmitMem( PFX_ES, bByte, OP_STORE, bResult, RM_DI );
+
+    /* Advance the pointers. */
+    if( bByte ) {
+        if( bUseS ) {
+            Emit( PFX_OPSIZE );                 /* inc esi */
+            Emit( 0x46 );
+        }
+        Emit( PFX_OPSIZE );                     /* inc edi */
+        Emit( 0x47 );
+    } else {
+        if( bUseS ) {
+            Emit( PFX_OPSIZE );                 /* add esi, 4 */
+            Emit( 0x83 );
+            Emit( MODRM_REG( 0, RM_SI ) );
+            Emit( 4 );
+        }
+        Emit( PFX_OPSIZE );                     /* add edi, 4 */
+        Emit( 0x83 );
+        Emit( MODRM_REG( 0, RM_DI ) );
+        Emit( 4 );
+    }
+}
+
+/* Compile the code for a ROP into a given slot. The dword loop is
+ * unrolled once per pattern dword so that the pattern can be addressed
+ * with constant displacements; it exits as soon as BP reaches zero.
+ * Returns zero if the code didn't fit.
+ */
+static int Rop3Compile( ROP3SLOT *pSlot, BYTE bRop, WORD wPatLen, WORD wTail )
+{
+    WORD    wTop;
+    WORD    wFixup[8];
+    WORD    i;
+
+    wPc       = (WORD)&Rop3Code + (pSlot - Rop3Slots) * ROP3_SLOT_SIZE;
+    wPcLimit  = wPc + ROP3_SLOT_SIZE;
+    bOverflow = 0;
+
+    /* The dword loop. */
+    wTop = wPc;
+    for( i = 0; i < wPatLen; ++i ) {
+        EmitPixelOp( 0, i * 4 );
+        Emit( 0x4D );                           /* dec bp */
+        Emit( 0x0F );                           /* jz near done */
+        Emit( 0x84 );
+        wFixup[i] = wPc;
+        EmitWord( 0 );
+    }
+    Emit( 0xE9 );                               /* jmp near top */
+    EmitWord( wTop - (wPc + 2) );
+    if( !bOverflow ) {
+        for( i = 0; i < wPatLen; ++i )
+            *(WORD __far *)&lpCode[wFixup[i]] = wPc - (wFixup[i] + 2);
+    }
+    Emit( 0xC3 );                               /* ret */
+
+    /* The trailing bytes, if any. */
+    pSlot->wTailOfs = 0;
+    if( wTail ) {
+        pSlot->wTailOfs = wPc;
+        for( i = 0; i < wTail; ++i )
+            EmitPixelOp( 1, i );
+        Emit( 0xC3 );                           /* ret */
+    }
+
+    return( !bOverflow );
+}
+
+/* Find compiled code for the current ROP in the cache, or compile it.
+ * Fills in the entry points in Rop3Job. Returns zero on failure.
+ */
+static int Rop3Lookup( BYTE bRop, WORD wPatLen, WORD wTail )
+{
+    WORD        wKey = ROP3KEY( bRop, wPatLen, wTail );
+    ROP3SLOT    *pSlot;
+    ROP3SLOT    *pVictim;
+
+    ++wRop3Clock;
+    pVictim = Rop3Slots;
+    for( pSlot = Rop3Slots; pSlot < Rop3Slots + ROP3_SLOTS; ++pSlot ) {
+        if( pSlot->wKey == wKey )
+            break;
+        if( (WORD)(wRop3Clock - pSlot->wLastUse) > (WORD)(wRop3Clock - pVictim->wLastUse) )
+            pVictim = pSlot;
+    }
+
+    if( pSlot == Rop3Slots + ROP3_SLOTS ) {
+        /* Not found, replace the least recently used slot. */
+        pSlot = pVictim;
+        pSlot->wKey = 0;
+        if( !Rop3Compile( pSlot, bRop, wPatLen, wTail ) ) {
+            dbg_printf( "Rop3Lookup: ROP %X does not fit!\n", bRop );
+            return( 0 );
+        }
+        pSlot->wKey = wKey;
+    }
+    pSlot->wLastUse = wRop3Clock;
+
+    Rop3Job.wEntry     = (WORD)&Rop3Code + (pSlot - Rop3Slots) * ROP3_SLOT_SIZE;
+    Rop3Job.wTailEntry = pSlot->wTailOfs;
+    return( 1 );
+}
+
+/* Check if the source bits can be combined with the destination as is. */
+static int Rop3SourceOK( LPDIBENGINE lpDst, LPDIBENGINE lpSrc )
+{
+    if( !lpSrc )
+        return( 0 );
+
+    /* The screen can always be a source. */
+    if( lpSrc == lpDst )
+        return( 1 );
+
+    /* Otherwise it must be a DIB Engine bitmap in system memory. */
+    if( lpSrc->deType != TYPE_DIBENG || (lpSrc->deFlags & (VRAM | NOT_FRAMEBUFFER)) )
+        return( 0 );
+
+    /* Pixel formats must be identical. */
+    if( lpSrc->deBitsPixel != lpDst->deBitsPixel )
+        return( 0 );
+    if( (lpSrc->deFlags ^ lpDst->deFlags) & FIVE6FIVE )
+        return( 0 );
+
+    /* DIB sections may need color translation or have odd masks. */
+    if( lpSrc->deFlags & SELECTEDDIB ) {
+        if( lpSrc->deBitsPixel == 8 )
+            return( 0 );
+        if( lpSrc->deBitmapInfo && lpSrc->deBitmapInfo->bmiHeader.biCompression != BI_RGB )
+            return( 0 );
+    }
+    return( 1 );
+}
+
+/* Called through BitBltDevProc; see dibcall.c for the preliminary checks. */
+BOOL WINAPI Rop3BitBlt( LPDIBENGINE lpDestDev, WORD wDestX, WORD wDestY, LPPDEVICE lpSrcDev,
+                        WORD wSrcX, WORD wSrcY, WORD wXext, WORD wYext, DWORD dwRop3,
+                        LPBRUSH lpPBrush, LPDRAWMODE lpDrawMode )
+{
+    LPDIBENGINE     lpSrc = lpSrcDev;
+    DIB_Brush8 FAR  *lpBrush = lpPBrush;
+    BYTE            bRop = (BYTE)(dwRop3 >> 16);
+    BYTE            bF0, bF1;
+    BYTE            bUseP;
+    WORD            wPixBytes;
+    WORD            wRowBytes;
+    WORD            wPatLen = 1;
+    WORD            wTail;
+    WORD            wLeft, wTop, wRight, wBottom;
+    int             bBottomUp = 0;
+    int             bBackward = 0;
+    KERNPROC        pfnKern = NULL;
+    int             i;
+
+    if( !wCodeAlias || lpDestDev->deBitsPixel < 8 )
+        goto punt;
+
+    if( !wXext || !wYext )
+        return( TRUE );
+
+    /* PATCOPY is a plain pattern fill. */
+    if( bRop == 0xF0 ) {
+        if( !PatSelect( lpDestDev, lpPBrush, lpDrawMode ) )
+            goto punt;
+        ((BEGINACCESSPROC)lpDestDev->deBeginAccess)( lpDestDev, wDestX, wDestY, wDestX + wXext - 1,
+                                                     wDestY + wYext - 1, CURSOREXCLUDE );
+        PatFillRect( wDestX, wDestY, wXext, wYext );
+        ((ENDACCESSPROC)lpDestDev->deEndAccess)( lpDestDev, CURSOREXCLUDE );
+        return( TRUE );
+    }
+
+    /* Monochrome sources are expanded to the text color (0 bits) and
+     * the background color (1 bits).
+     */
+    if( bRop == 0xCC && lpSrc && lpSrc->deBitsPixel == 1 ) {
+        if( !lpDrawMode || lpSrc->deType != TYPE_DIBENG || (lpSrc->deFlags & (VRAM | NOT_FRAMEBUFFER | SELECTEDDIB)) )
+            goto punt;
+        MonoSetColors( lpDestDev->deBitsPixel, lpDrawMode->LbkColor, lpDrawMode->LTextColor );
+        ((BEGINACCESSPROC)lpDestDev->deBeginAccess)( lpDestDev, wDestX, wDestY, wDestX + wXext - 1,
+                                                     wDestY + wYext - 1, CURSOREXCLUDE );
+        MonoExpand( lpDestDev, wDestX, wDestY, wXext, wYext, lpSrc->deBitsSelector,
+                    lpSrc->deBitsOffset + (long)wSrcY * (long)lpSrc->deDeltaScan + (wSrcX >> 3),
+                    wSrcX & 7, lpSrc->deDeltaScan, 0 );
+        ((ENDACCESSPROC)lpDestDev->deEndAccess)( lpDestDev, CURSOREXCLUDE );
+        return( TRUE );
+    }
+
+    /* Split the ROP into the two halves for D=0 and D=1. */
+    bF0 = bF1 = 0;
+    for( i = 0; i < 4; ++i ) {
+        bF0 |= ((bRop >> (2 * i)) & 1) << i;
+        bF1 |= ((bRop >> (2 * i + 1)) & 1) << i;
+    }
+    bG0   = bF0;
+    bG2   = bF0 ^ bF1;
+    bUseS = FN_USES_S( bG0 ) || FN_USES_S( bG2 );
+    bUseP = FN_USES_P( bG0 ) || FN_USES_P( bG2 );
+
+    wPixBytes = lpDestDev->deBitsPixel >> 3;
+
+    if( bUseS ) {
+        if( !Rop3SourceOK( lpDestDev, lpSrc ) )
+            goto punt;
+
+        /* The compiled code only runs forward. Overlapping blits on
+         * the same scanlines that move to the right can only be done
+         * as a plain copy.
+         */
+        if( lpSrc == lpDestDev && wSrcY == wDestY && wDestX > wSrcX && wDestX < wSrcX + wXext ) {
+            if( bRop != 0xCC )
+                goto punt;
+            bBackward = 1;
+        }
+        bBottomUp = lpSrc == lpDestDev && wDestY > wSrcY;
+    }
+
+    if( bUseP ) {
+        if( !lpBrush || lpBrush->dp8BrushStyle == BS_HOLLOW || lpBrush->dp8BrushBpp != lpDestDev->deBitsPixel )
+            goto punt;
+        /* Transparent hatches need the mask. */
+        if( lpBrush->dp8BrushStyle == BS_HATCHED && lpDrawMode && lpDrawMode->bkMode == TRANSPARENT )
+            goto punt;
+        wPatLen = PatBuild( lpBrush, wDestX, wPixBytes );
+    }
+
+    /* SRCCOPY doesn't need compiled code. */
+    if( bRop == 0xCC )
+        pfnKern = bBackward ? Kern.pfnCopyBack : Kern.pfnCopy;
+
+    wRowBytes = wXext * wPixBytes;
+    wTail     = wRowBytes & 3;
+    if( !pfnKern && !Rop3Lookup( bRop, wPatLen, wTail ) )
+        goto punt;
+
+    /* Fill out the rest of the job. */
+    Rop3Job.wDwords   = wRowBytes >> 2;
+    Rop3Job.wTailPat  = (Rop3Job.wDwords % wPatLen) * 4;
+    Rop3Job.wRows     = wYext;
+    Rop3Job.wDstSel   = lpDestDev->deBitsSelector;
+    Rop3Job.lDstDelta = lpDestDev->deDeltaScan;
+    Rop3Job.dwDstOfs  = lpDestDev->deBitsOffset + (long)wDestY * (long)lpDestDev->deDeltaScan
+                      + (DWORD)wDestX * wPixBytes;
+    Rop3Job.wPatRow   = wDestY & 7;
+    Rop3Job.wPatStep  = 1;
+    Rop3Job.wSrcSel   = 0;
+    Rop3Job.dwSrcOfs  = 0;
+    Rop3Job.lSrcDelta = 0;
+    if( bUseS ) {
+        Rop3Job.wSrcSel   = lpSrc->deBitsSelector;
+        Rop3Job.lSrcDelta = lpSrc->deDeltaScan;
+        Rop3Job.dwSrcOfs  = lpSrc->deBitsOffset + (long)wSrcY * (long)lpSrc->deDeltaScan
+                          + (DWORD)wSrcX * wPixBytes;
+    }
+    if( bBottomUp ) {
+        /* Start with the last scanline and go backwards. */
+        Rop3Job.dwDstOfs  += (wYext - 1) * Rop3Job.lDstDelta;
+        Rop3Job.dwSrcOfs  += (wYext - 1) * Rop3Job.lSrcDelta;
+        Rop3Job.lDstDelta  = -Rop3Job.lDstDelta;
+        Rop3Job.lSrcDelta  = -Rop3Job.lSrcDelta;
+        Rop3Job.wPatRow    = (wDestY + wYext - 1) & 7;
+        Rop3Job.wPatStep   = -1;
+    }
+
+    /* Keep the cursor out of the way, including the source if on screen. */
+    wLeft   = wDestX;
+    wTop    = wDestY;
+    wRight  = wDestX + wXext - 1;
+    wBottom = wDestY + wYext - 1;
+    if( bUseS && lpSrc == lpDestDev ) {
+        if( wSrcX < wLeft )
+            wLeft = wSrcX;
+        if( wSrcY < wTop )
+            wTop = wSrcY;
+        if( wSrcX + wXext - 1 > wRight )
+            wRight = wSrcX + wXext - 1;
+        if( wSrcY + wYext - 1 > wBottom )
+            wBottom = wSrcY + wYext - 1;
+    }
+
+    ((BEGINACCESSPROC)lpDestDev->deBeginAccess)( lpDestDev, wLeft, wTop, wRight, wBottom, CURSOREXCLUDE );
+    if( pfnKern ) {
+        KernJob.wDstSel   = Rop3Job.wDstSel;
+        KernJob.dwDstOfs  = Rop3Job.dwDstOfs;
+        KernJob.lDstPitch = Rop3Job.lDstDelta;
+        KernJob.wSrcSel   = Rop3Job.wSrcSel;
+        KernJob.dwSrcOfs  = Rop3Job.dwSrcOfs;
+        KernJob.lSrcPitch = Rop3Job.lSrcDelta;
+        KernJob.wWidth    = wXext;
+        KernJob.wHeight   = wYext;
+        pfnKern();
+    } else {
+        Rop3Run();
+    }
+    ((ENDACCESSPROC)lpDestDev->deEndAccess)( lpDestDev, CURSOREXCLUDE );
+    return( TRUE );
+
+punt:
+    return( DIB_BitBlt( lpDestDev, wDestX, wDestY, lpSrcDev, wSrcX, wSrcY, wXext, wYext, dwRop3, lpPBrush, lpDrawMode ) );
+}
+
+#pragma code_seg( _INIT )
+
+/* Set up the writable alias of the code buffer. */
+void Rop3Init( void )
+{
+    if( !wCodeAlias ) {
+        wCodeAlias = AllocCStoDSAlias( (__segment)&Rop3Code );
+        lpCode     = wCodeAlias :> 0;
+        dbg_printf( "Rop3Init: wCodeAlias=%X\n", wCodeAlias );
+    }
+}
+
+/* Release the alias; compiled code can't be trusted after that. */
+void Rop3Term( void )
+{
+    WORD    i;
+
+    if( wCodeAlias ) {
+        FreeSelector( wCodeAlias );
+        wCodeAlias = 0;
+        for( i = 0; i < ROP3_SLOTS; ++i )
+            Rop3Slots[i].wKey = 0;
+    }
+}
@@ -0,0 +1,130 @@
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;
+; Copyright (c) 2022  Michal Necasek
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+;
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+
+; Support code for the compiled ROP3 BitBlt, see rop3.c.
+
+; Size of the code buffer, must match ROP3_CODE_SIZE in rop3.c.
+ROP3_CODE_SIZE	equ	5120
+
+; Offsets into the ROP3JOB structure, must match rop3.c.
+RJ_ENTRY	equ	0
+RJ_TAILENTRY	equ	2
+RJ_TAILPAT	equ	4
+RJ_PATROW	equ	6
+RJ_PATSTEP	equ	8
+RJ_DWORDS	equ	10
+RJ_ROWS		equ	12
+RJ_DSTSEL	equ	14
+RJ_SRCSEL	equ	16
+RJ_DSTOFS	equ	18
+RJ_DSTDELTA	equ	22
+RJ_SRCOFS	equ	26
+RJ_SRCDELTA	equ	30
+
+public	_Rop3Code
+public	Rop3Run_
+
+_DATA	segment public 'DATA'
+
+; Defined in C code.
+extrn	_Rop3Job : byte
+extrn	_PatRows : dword
+
+_DATA	ends
+
+DGROUP	group	_DATA
+
+_TEXT	segment	public 'CODE'
+
+.386
+assume	ds:DGROUP, es:nothing
+
+; The compiled code lives here. Written through an alias selector.
+_Rop3Code	db	ROP3_CODE_SIZE dup (0CCh)
+
+; Run the compiled code over all scanlines described by _Rop3Job.
+; The compiled code expects ES:EDI to point to the destination,
+; FS:ESI to the source, DS:BX to the current pattern row, and BP
+; to hold the number of dwords. It modifies EAX, ECX, EDX, ESI,
+; EDI, and BP.
+Rop3Run_	proc	near
+
+	pushad
+	push	es
+	push	fs
+
+	mov	es, word ptr _Rop3Job[RJ_DSTSEL]
+	mov	fs, word ptr _Rop3Job[RJ_SRCSEL]
+	mov	edi, dword ptr _Rop3Job[RJ_DSTOFS]
+	mov	esi, dword ptr _Rop3Job[RJ_SRCOFS]
+
+row_loop:
+	push	esi
+	push	edi
+
+	; Point BX at the pattern row; each row is 64 bytes.
+	mov	bx, word ptr _Rop3Job[RJ_PATROW]
+	shl	bx, 6
+	add	bx, offset DGROUP:_PatRows
+
+	; Process full dwords, if any.
+	mov	bp, word ptr _Rop3Job[RJ_DWORDS]
+	or	bp, bp
+	jz	do_tail
+	call	word ptr _Rop3Job[RJ_ENTRY]
+
+do_tail:
+	; Process the remaining bytes, if any.
+	mov	ax, word ptr _Rop3Job[RJ_TAILENTRY]
+	or	ax, ax
+	jz	next_row
+	add	bx, word ptr _Rop3Job[RJ_TAILPAT]
+	call	ax
+
+next_row:
+	pop	edi
+	pop	esi
+	add	edi, dword ptr _Rop3Job[RJ_DSTDELTA]
+	add	esi, dword ptr _Rop3Job[RJ_SRCDELTA]
+
+	; Step to the next pattern row.
+	mov	ax, word ptr _Rop3Job[RJ_PATROW]
+	add	ax, word ptr _Rop3Job[RJ_PATSTEP]
+	and	ax, 7
+	mov	word ptr _Rop3Job[RJ_PATROW], ax
+
+	dec	word ptr _Rop3Job[RJ_ROWS]
+	jnz	row_loop
+
+	pop	fs
+	pop	es
+	popad
+	ret
+
+Rop3Run_	endp
+
+_TEXT	ends
+
+end
@@ -84,6 +84,14 @@ void SwitchToBgnd( void )
 {
     dbg_printf( "SwitchToBgnd\n" );
 
+    /* Leave a complete picture behind. Flush under the lock like anyone
+     * else, or the shadow timer could start a flush of its own meanwhile.
+     */
+    if( !wAccessLock ) {
+        ++wAccessLock;
+        ShadowFlush();
+        --wAccessLock;
+    }
     lpDriverPDevice->deFlags |= BUSY;   /// @todo Does this need to be a locked op?
 }
 
@@ -157,13 +165,6 @@ void DOSSetIntVec( BYTE bIntNo, void __far *NewVector );
 /* Ordinal of the repaint callback in USER. Of course undocumented. */
 #define REPAINT_ORDINAL     275
 
-/* Fun times. Undocumented function to create a writable alias of a code
- * selector. In MS KB Q67165, Microsoft claimed that the function "is not
- * documented and will not be supported in future versions of Windows".
- * Clearly they lied, as it happily works on Win9x.
- */
-extern UINT WINAPI AllocCStoDSAlias( UINT selCode );
-
 /* Internal function to install INT 2Fh hook. */
 void HookInt2Fh( void )
 {
@@ -0,0 +1,292 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* Shadow framebuffer. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+/* When enabled with 'shadowfb=1' in the [display] section of SYSTEM.INI,
+ * the DIB Engine and the driver draw into a copy of the screen in system
+ * memory, so that read-modify-write operations never read VRAM. Every
+ * surface access marks its rectangle dirty in a grid of tiles. Dirty
+ * tiles are copied to VRAM from a system timer and at sync points (cursor
+ * moves, screen switches); runs of adjacent dirty tiles are copied as one
+ * rectangle, so scattered small writes turn into long scanline copies.
+ *
+ * With 'pixeldouble=1', the mode is programmed at twice the GDI size in
+ * each direction (see FixVirtualSize) and the shadow surface is required.
+ * Flushing then writes every pixel as a 2x2 block, so GDI draws a quarter
+ * of the pixels on a large screen.
+ *
+ * Dirty marking and flushing only happen while the surface access lock
+ * (wAccessLock, see cursor.c) is held, so the timer never races the
+ * foreground.
+ */
+
+#define SHADOW_TICK     20      /* Flush interval in milliseconds. */
+#define TILE_MAXCOLS    32      /* One DWORD per row of tiles. */
+#define TILE_MAXROWS    128
+
+/* SYSTEM.DRV timer services. */
+extern WORD WINAPI CreateSystemTimer( WORD wRate, FARPROC lpfnCallback );
+extern WORD WINAPI KillSystemTimer( WORD hTimer );
+
+/* Timer entry point which preserves all registers (sswhook.asm). */
+extern void __far ShadowTimerHook( void );
+
+WORD    wShadowFB = 0;          /* Shadow framebuffer requested. */
+WORD    wShadowSel = 0;         /* Shadow surface selector, zero if none. */
+WORD    wPixelDouble = 0;       /* Pixel doubling requested. */
+WORD    wDoubled = 0;           /* Pixel doubling in effect. */
+
+static HGLOBAL  hShadow;
+static DWORD    dwShadowSize;
+static WORD     wShadowTimer;
+static WORD     wShadowW;               /* Surface size. */
+static WORD     wShadowH;
+static DWORD    dwShadowPitch;
+static WORD     wShadowBytes;           /* Bytes per pixel. */
+static WORD     wTileXShift;            /* Tile size, as a power of two. */
+static WORD     wTileYShift;
+static WORD     wTileRows;
+static DWORD    DirtyRow[TILE_MAXROWS]; /* One bit per dirty tile. */
+
+/* Release the shadow surface, if any. */
+static void ShadowFree( void )
+{
+    if( hShadow ) {
+        GlobalUnlock( hShadow );
+        GlobalFree( hShadow );
+        hShadow      = 0;
+        wShadowSel   = 0;
+        dwShadowSize = 0;
+    }
+}
+
+/* Allocate the shadow surface for a wWidth x wHeight screen. Returns the
+ * selector, or zero if the screen should be used directly. The surface
+ * uses the screen's pitch so that tiles are at the same offsets in both.
+ */
+WORD ShadowAlloc( WORD wWidth, WORD wHeight, WORD wBitsPixel, WORD wPitch )
+{
+    DWORD   dwPitch = wPitch;
+    DWORD   dwSize  = dwPitch * wHeight;
+
+    /* The setting may change when the mode does (see ReEnable). */
+    if( !(wShadowFB || wDoubled) || wBitsPixel < 8 ) {
+        ShadowFree();
+        return( 0 );
+    }
+
+    if( dwSize > dwShadowSize ) {
+        ShadowFree();
+        /* Fixed memory owned by a DLL is page locked, and in enhanced
+         * mode the first selector of a large block spans all of it.
+         */
+        hShadow = GlobalAlloc( GMEM_FIXED | GMEM_SHARE | GMEM_ZEROINIT, dwSize );
+        if( !hShadow ) {
+            dbg_printf( "ShadowAlloc: cannot allocate %lX bytes\n", dwSize );
+            return( 0 );
+        }
+        wShadowSel   = (__segment)GlobalLock( hShadow );
+        dwShadowSize = dwSize;
+    }
+
+    wShadowW      = wWidth;
+    wShadowH      = wHeight;
+    dwShadowPitch = dwPitch;
+    wShadowBytes  = wBitsPixel >> 3;
+
+    /* Pick the smallest tiles that fit the grid. */
+    for( wTileXShift = 5; ((wWidth - 1) >> wTileXShift) >= TILE_MAXCOLS; ++wTileXShift )
+        ;
+    for( wTileYShift = 3; ((wHeight - 1) >> wTileYShift) >= TILE_MAXROWS; ++wTileYShift )
+        ;
+    wTileRows = ((wHeight - 1) >> wTileYShift) + 1;
+    ShadowInvalidate();
+
+    if( !wShadowTimer )
+        wShadowTimer = CreateSystemTimer( SHADOW_TICK, (FARPROC)ShadowTimerHook );
+    return( wShadowSel );
+}
+
+/* Stop flushing, e.g. when the driver is disabled. */
+void ShadowStop( void )
+{
+    if( wShadowTimer ) {
+        KillSystemTimer( wShadowTimer );
+        wShadowTimer = 0;
+    }
+}
+
+/* Mark the whole screen dirty. */
+void ShadowInvalidate( void )
+{
+    WORD    i;
+
+    for( i = 0; i < wTileRows; ++i )
+        DirtyRow[i] = 0xFFFFFFFF;
+}
+
+/* Find the tiles covering an inclusive rectangle: rows *pwRow0 through
+ * *pwRow1, columns as a mask. Returns a zero mask if there are none.
+ */
+static DWORD ShadowTiles( int iLeft, int iTop, int iRight, int iBottom, WORD *pwRow0, WORD *pwRow1 )
+{
+    WORD    wCol0, wCol1;
+
+    if( !wShadowSel )
+        return( 0 );
+    if( iLeft < 0 )
+        iLeft = 0;
+    if( iTop < 0 )
+        iTop = 0;
+    if( iRight >= (int)wShadowW )
+        iRight = wShadowW - 1;
+    if( iBottom >= (int)wShadowH )
+        iBottom = wShadowH - 1;
+    if( iLeft > iRight || iTop > iBottom )
+        return( 0 );
+
+    wCol0   = iLeft >> wTileXShift;
+    wCol1   = iRight >> wTileXShift;
+    *pwRow0 = iTop >> wTileYShift;
+    *pwRow1 = iBottom >> wTileYShift;
+    return( (wCol1 == 31 ? 0xFFFFFFFF : (1UL << (wCol1 + 1)) - 1) & ~((1UL << wCol0) - 1) );
+}
+
+/* Mark an inclusive rectangle dirty. The caller holds the access lock. */
+void ShadowDirty( int iLeft, int iTop, int iRight, int iBottom )
+{
+    DWORD   dwMask;
+    WORD    wRow, wRow1;
+
+    dwMask = ShadowTiles( iLeft, iTop, iRight, iBottom, &wRow, &wRow1 );
+    if( !dwMask )
+        return;
+    for( ; wRow <= wRow1; ++wRow )
+        DirtyRow[wRow] |= dwMask;
+}
+
+/* Copy the dirty tiles in rows wRow0 up to wRowEnd (exclusive) and the
+ * columns in dwColMask to the screen.
+ */
+static void ShadowCopy( WORD wRow0, WORD wRowEnd, DWORD dwColMask )
+{
+    KERNJOB     SavedJob;
+    DWORD       dwMask;
+    WORD        wRow, wRow1, wCol, wCol1;
+    WORD        wTop, wBottom, wLeft, wRight;
+    DWORD       dwOfs;
+    int         bSaved = 0;
+
+    if( !wShadowSel || (lpDriverPDevice->deFlags & BUSY) )
+        return;
+
+    for( wRow = wRow0; wRow < wRowEnd; wRow = wRow1 ) {
+        dwMask = DirtyRow[wRow] & dwColMask;
+        DirtyRow[wRow] &= ~dwColMask;
+        /* Rows of tiles with the same mask are copied together. */
+        for( wRow1 = wRow + 1; wRow1 < wRowEnd && (DirtyRow[wRow1] & dwColMask) == dwMask; ++wRow1 )
+            DirtyRow[wRow1] &= ~dwColMask;
+        if( !dwMask )
+            continue;
+
+        if( !bSaved ) {
+            SavedJob = KernJob;
+            bSaved   = 1;
+        }
+        wTop    = wRow << wTileYShift;
+        wBottom = wRow1 << wTileYShift;
+        if( wBottom > wShadowH )
+            wBottom = wShadowH;
+        for( wCol = 0; wCol < TILE_MAXCOLS; wCol = wCol1 ) {
+            if( !(dwMask & (1UL << wCol)) ) {
+                wCol1 = wCol + 1;
+                continue;
+            }
+            for( wCol1 = wCol + 1; wCol1 < TILE_MAXCOLS && (dwMask & (1UL << wCol1)); ++wCol1 )
+                ;
+            wLeft  = wCol << wTileXShift;
+            wRight = wCol1 << wTileXShift;
+            if( wRight > wShadowW )
+                wRight = wShadowW;
+            if( wLeft >= wRight )
+                break;
+
+            dwOfs = wTop * dwShadowPitch + wLeft * wShadowBytes;
+            KernJob.wDstSel   = ScreenSelector;
+            KernJob.dwDstOfs  = dwOfs;
+            KernJob.lDstPitch = dwShadowPitch;
+            KernJob.wSrcSel   = wShadowSel;
+            KernJob.dwSrcOfs  = dwOfs;
+            KernJob.lSrcPitch = dwShadowPitch;
+            KernJob.wWidth    = wRight - wLeft;
+            KernJob.wHeight   = wBottom - wTop;
+            if( wDoubled ) {
+                KernJob.dwDstOfs  = 2 * (wTop * (DWORD)wScreenPitchBytes + wLeft * wShadowBytes);
+                KernJob.lDstPitch = wScreenPitchBytes;
+                Kern.pfnDouble();
+            } else {
+                Kern.pfnCopy();
+            }
+        }
+    }
+    if( bSaved )
+        KernJob = SavedJob;
+}
+
+/* Copy all dirty tiles to the screen. The caller holds the access lock. */
+void ShadowFlush( void )
+{
+    ShadowCopy( 0, wTileRows, 0xFFFFFFFF );
+}
+
+/* Copy the dirty tiles within an inclusive rectangle to the screen, e.g.
+ * around the cursor; the timer takes care of the rest. The caller holds
+ * the access lock.
+ */
+void ShadowFlushRect( int iLeft, int iTop, int iRight, int iBottom )
+{
+    DWORD   dwMask;
+    WORD    wRow, wRow1;
+
+    dwMask = ShadowTiles( iLeft, iTop, iRight, iBottom, &wRow, &wRow1 );
+    if( dwMask )
+        ShadowCopy( wRow, wRow1 + 1, dwMask );
+}
+
+/* Called from the system timer through ShadowTimerHook. */
+void ShadowTick( void )
+{
+    if( wAccessLock || !wEnabled )
+        return;
+    ++wAccessLock;
+    ShadowFlush();
+    --wAccessLock;
+}
@@ -0,0 +1,182 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* Screen snapshots for applications. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+#include "boxvesc.h"
+
+/* Flat addresses a dwLinear destination may use: the private arena of a
+ * Win32 process, below the shared arena and system memory.
+ */
+#define SNAP_LINEAR_MIN     0x00400000UL
+#define SNAP_LINEAR_END     0x80000000UL
+
+/* Pixels are converted to 0RGB by looking up the low and high bytes of
+ * each source pixel and ORing the results: 8bpp pixels only use the low
+ * table, 15bpp and 16bpp pixels split their fields between the two
+ * tables. 24bpp and 32bpp screens need no tables.
+ */
+DWORD   SnapLo[256];
+DWORD   SnapHi[256];
+
+/* Conversion kernels, by screen bytes per pixel - 1 and output format. */
+static const KERNPROC SnapKern[4][2] = {
+    { KernSnap8to24,  KernSnap8to32 },
+    { KernSnap16to24, KernSnap16to32 },
+    { KernSnap24to24, KernSnap24to32 },
+    { KernSnap32to24, KernSnap32to32 }
+};
+
+/* Expand a 5-bit color component to 8 bits. */
+static WORD SnapComp5( WORD wVal )
+{
+    return( (wVal << 3) | (wVal >> 2) );
+}
+
+/* Set up the tables for the screen format. Green straddles the two
+ * bytes; its replicated low bits come from whichever byte holds the
+ * top green bits, so the two halves never overlap.
+ */
+static void SnapTables( LPDIBENGINE lpDev )
+{
+    WORD    i, g;
+
+    for( i = 0; i < 256; ++i ) {
+        if( lpDev->deBitsPixel == 8 ) {
+            SnapLo[i] = *(DWORD FAR *)&lpColorTable[i] & 0xFFFFFF;
+        } else if( lpDev->deFlags & FIVE6FIVE ) {
+            /* RRRRRGGG GGGBBBBB */
+            g = (i & 7) << 5;
+            SnapHi[i] = ((DWORD)SnapComp5( i >> 3 ) << 16) | ((g | (g >> 6)) << 8);
+            SnapLo[i] = SnapComp5( i & 0x1F ) | (((i >> 5) << 2) << 8);
+        } else {
+            /* 0RRRRRGG GGGBBBBB */
+            g = (i & 3) << 6;
+            SnapHi[i] = ((DWORD)SnapComp5( (i >> 2) & 0x1F ) << 16) | ((g | (g >> 5)) << 8);
+            SnapLo[i] = SnapComp5( i & 0x1F ) | ((((i >> 5) << 3) | (i >> 7)) << 8);
+        }
+    }
+}
+
+/* Handle BOXV_ESC_SNAPSHOT. */
+int SnapEscape( LPVOID lpInData, LPVOID lpOutData )
+{
+    BOXV_SNAPSHOT FAR   *lpSnap = lpInData;
+    LPDIBENGINE         lpDev = lpDriverPDevice;
+    KERNPROC            pfnSnap;
+    RECT                rc;
+    WORD                wSel = 0;
+    WORD                wBytes;
+    WORD                wHeight;
+    DWORD               dwSize;
+    DWORD               dwLimit;
+
+    if( !lpSnap || !wEnabled || (lpDev->deFlags & BUSY) || lpDev->deBitsPixel < 8 )
+        return( -1 );
+
+    rc.left   = lpSnap->rc.left;
+    rc.top    = lpSnap->rc.top;
+    rc.right  = lpSnap->rc.right;
+    rc.bottom = lpSnap->rc.bottom;
+    if( rc.left < 0 || rc.top < 0 || rc.right > lpDev->deWidth || rc.bottom > lpDev->deHeight
+      || rc.left >= rc.right || rc.top >= rc.bottom )
+        return( -1 );
+
+    wBytes = lpDev->deBitsPixel >> 3;
+    switch( lpSnap->wBpp ) {
+    case 0:
+        pfnSnap = Kern.pfnCopy;
+        break;
+    case 24:
+    case 32:
+        pfnSnap = SnapKern[wBytes - 1][lpSnap->wBpp == 32];
+        if( wBytes <= 2 )
+            SnapTables( lpDev );
+        break;
+    default:
+        return( -1 );
+    }
+
+    /* Bytes written: all rows but the last in full, then one row's pixels. */
+    wHeight = rc.bottom - rc.top;
+    dwSize  = (DWORD)(rc.right - rc.left) * (lpSnap->wBpp ? lpSnap->wBpp >> 3 : wBytes);
+    if( lpSnap->dwPitch < dwSize || lpSnap->dwPitch > (0xFFFFFFFFUL - dwSize) / wHeight )
+        return( -1 );
+    dwSize += lpSnap->dwPitch * (wHeight - 1);
+
+    if( lpSnap->dwLinear ) {
+        /* Flat memory of the calling process; it is current while the
+         * escape runs. Only the private arena (4MB up to 2GB) is allowed,
+         * never shared or system memory.
+         */
+        if( lpSnap->dwLinear < SNAP_LINEAR_MIN || lpSnap->dwLinear > SNAP_LINEAR_END
+          || dwSize > SNAP_LINEAR_END - lpSnap->dwLinear )
+            return( -1 );
+        wSel = AllocSelector( (__segment)lpSnap );
+        if( !wSel )
+            return( -1 );
+        SetSelectorBase( wSel, lpSnap->dwLinear );
+        SetSelectorLimit( wSel, dwSize - 1 );
+        KernJob.wDstSel  = wSel;
+        KernJob.dwDstOfs = 0;
+    } else {
+        /* The buffer must hold the whole rectangle. */
+        if( !lpOutData )
+            return( -1 );
+        dwLimit = GetSelectorLimit( (__segment)lpOutData );
+        if( (WORD)(DWORD)lpOutData > dwLimit || dwSize - 1 > dwLimit - (WORD)(DWORD)lpOutData )
+            return( -1 );
+        KernJob.wDstSel  = (__segment)lpOutData;
+        KernJob.dwDstOfs = (WORD)(DWORD)lpOutData;
+    }
+    KernJob.lDstPitch = lpSnap->dwPitch;
+    KernJob.wSrcSel   = lpDev->deBitsSelector;
+    KernJob.dwSrcOfs  = lpDev->deBitsOffset + (long)rc.top * lpDev->deDeltaScan + rc.left * wBytes;
+    KernJob.lSrcPitch = lpDev->deDeltaScan;
+    KernJob.wWidth    = rc.right - rc.left;
+    KernJob.wHeight   = wHeight;
+
+    /* The lock keeps interrupt-time cursor and shadow code off KernJob
+     * and the kernels while the copy runs. The access callbacks are not
+     * used since they would report the rectangle as drawn.
+     */
+    if( lpSnap->wFlags & BOXV_SNAP_NOCURSOR ) {
+        CursorExclude( lpDev, rc.left, rc.top, rc.right - 1, rc.bottom - 1 );
+        pfnSnap();
+        CursorUnexclude( lpDev );
+    } else {
+        ++wAccessLock;
+        pfnSnap();
+        --wAccessLock;
+    }
+
+    if( wSel )
+        FreeSelector( wSel );
+    return( 1 );
+}
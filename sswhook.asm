@@ -36,10 +36,12 @@ FLAG_CF			equ	0001h
 
 public	_OldInt2Fh
 public	SWHook_
+public	ShadowTimerHook_
 
 ; Callbacks written in C
 extrn	SwitchToBgnd_ : far
 extrn	SwitchToFgnd_ : far
+extrn	ShadowTick_ : near
 
 _DATA   segment public 'DATA'
 
@@ -121,6 +123,33 @@ exit:
 
 SWHook_	endp
 
+;; System timer callback for the shadow framebuffer. Timer callbacks run
+;; at interrupt time and may interrupt 32-bit code, so all registers are
+;; preserved around the C handler.
+ShadowTimerHook_	proc	far
+
+	assume	ds:nothing, es:nothing
+	push	ds
+	push	es
+	push	fs
+	push	gs
+	pushad
+
+	mov	bx, _DATA
+	mov	ds, bx
+	assume	ds:DGROUP
+
+	call	ShadowTick_
+
+	popad
+	pop	gs
+	pop	fs
+	pop	es
+	pop	ds
+	ret
+
+ShadowTimerHook_	endp
+
 
 _TEXT	ends
 	end
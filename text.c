@@ -0,0 +1,354 @@
+/*****************************************************************************
+
+Copyright (c) 2022  Michal Necasek
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*****************************************************************************/
+
+
+/* ExtTextOut for raster fonts on the screen. */
+
+#include "winhack.h"
+#include <gdidefs.h>
+#include <dibeng.h>
+#include "minidrv.h"
+
+/* A raster font in the 3.0 format, as GDI passes it to devices with
+ * RC_BIGFONT. Declared here byte packed; FONTINFO in gdidefs.h only
+ * covers the 2.0 header.
+ */
+#pragma pack( push, 1 )
+
+typedef struct {
+    WORD    geWidth;            /* Glyph width in pixels. */
+    DWORD   geOffset;           /* Glyph bits, relative to the font. */
+} GLYPH30;
+
+typedef struct {
+    short   dfType;
+    short   dfPoints;
+    short   dfVertRes;
+    short   dfHorizRes;
+    short   dfAscent;
+    short   dfInternalLeading;
+    short   dfExternalLeading;
+    BYTE    dfItalic;
+    BYTE    dfUnderline;
+    BYTE    dfStrikeOut;
+    short   dfWeight;
+    BYTE    dfCharSet;
+    short   dfPixWidth;
+    short   dfPixHeight;
+    BYTE    dfPitchAndFamily;
+    short   dfAvgWidth;
+    short   dfMaxWidth;
+    BYTE    dfFirstChar;
+    BYTE    dfLastChar;
+    BYTE    dfDefaultChar;
+    BYTE    dfBreakChar;
+    short   dfWidthBytes;
+    DWORD   dfDevice;
+    DWORD   dfFace;
+    DWORD   dfBitsPointer;
+    DWORD   dfBitsOffset;
+    BYTE    dfReserved;
+    DWORD   dfFlags;
+    short   dfAspace;
+    short   dfBspace;
+    short   dfCspace;
+    DWORD   dfColorPointer;
+    DWORD   dfReserved1[4];
+    GLYPH30 dfCharTable[1];
+} FONT30;
+
+#pragma pack( pop )
+
+typedef FONT30 FAR *LPFONT30;
+
+/* Font flags. Only plain monochrome fonts without ABC spacing are
+ * handled here.
+ */
+#define DFF_FIXED           0x0001
+#define DFF_PROPORTIONAL    0x0002
+#define DFF_UNSUPPORTED     0xFFFC
+
+/* Glyphs are assembled into a monochrome band holding the visible rows
+ * of the string, which is then expanded to the screen in one pass.
+ */
+#define TEXT_BAND_SIZE      8192    /* Bytes in the band buffer. */
+#define TEXT_BAND_PITCH     1024    /* Widest band row in bytes. */
+
+static LPDIBENGINE  lpTextDev;
+static RECT         rcTextClip;     /* Glyph clip, exclusive right/bottom. */
+static WORD         wBandSel;       /* Band segment, zero if none. */
+static int          xBand;          /* Screen position of the band. */
+static int          yBand;
+static WORD         wBandRows;      /* Scanlines in the band. */
+static WORD         wBandPitch;     /* Bytes per band row. */
+static WORD         wBandBits;      /* Pixels assembled so far. */
+static int          bBandTransparent;
+
+/* Intersect two rectangles into the first one. Returns zero if empty. */
+static int TextClip( RECT *pRect, LPRECT lpClip )
+{
+    if( pRect->left < lpClip->left )
+        pRect->left = lpClip->left;
+    if( pRect->top < lpClip->top )
+        pRect->top = lpClip->top;
+    if( pRect->right > lpClip->right )
+        pRect->right = lpClip->right;
+    if( pRect->bottom > lpClip->bottom )
+        pRect->bottom = lpClip->bottom;
+    return( pRect->left < pRect->right && pRect->top < pRect->bottom );
+}
+
+/* Fill a rectangle with the background color, clipped to rcClip. */
+static void TextFill( int left, int top, int right, int bottom, RECT *pClip, DWORD dwColor )
+{
+    RECT    rc;
+
+    rc.left   = left;
+    rc.top    = top;
+    rc.right  = right;
+    rc.bottom = bottom;
+    if( !TextClip( &rc, pClip ) )
+        return;
+
+    KernJob.wDstSel   = lpTextDev->deBitsSelector;
+    KernJob.lDstPitch = lpTextDev->deDeltaScan;
+    KernJob.dwDstOfs  = lpTextDev->deBitsOffset + (long)rc.top * lpTextDev->deDeltaScan
+                      + (DWORD)rc.left * (lpTextDev->deBitsPixel >> 3);
+    KernJob.wWidth    = rc.right - rc.left;
+    KernJob.wHeight   = rc.bottom - rc.top;
+    KernJob.dwColor   = dwColor;
+    Kern.pfnFill();
+}
+
+/* Expand the assembled band to the screen, clipped to rcTextClip, and
+ * empty it.
+ */
+static void TextBandFlush( void )
+{
+    int     xLeft  = xBand;
+    int     xRight = xBand + wBandBits;
+
+    if( xLeft < rcTextClip.left )
+        xLeft = rcTextClip.left;
+    if( xRight > rcTextClip.right )
+        xRight = rcTextClip.right;
+    if( xLeft < xRight )
+        MonoExpand( lpTextDev, xLeft, yBand, xRight - xLeft, wBandRows, wBandSel,
+                    (xLeft - xBand) >> 3, (xLeft - xBand) & 7, wBandPitch, bBandTransparent );
+    wBandBits = 0;
+}
+
+/* Append a glyph wWidth pixels wide at screen position x to the band.
+ * Raster font glyphs are stored in columns 8 pixels wide, each column
+ * wHeight bytes long; wOfs points at the first visible row of the first
+ * column. Glyphs are appended left to right, so each column byte only
+ * keeps the band bits before it and starts the next byte afresh.
+ */
+static void TextBandAdd( int x, WORD wWidth, WORD wHeight, WORD wSel, WORD wOfs )
+{
+    BYTE __far  *lpSrc = wSel :> wOfs;
+    BYTE __far  *lpDst;
+    WORD        wPos, wShift, wRow;
+    BYTE        bKeep, b;
+
+    if( wBandBits && ((wBandBits + wWidth + 7) >> 3) + 1 > wBandPitch )
+        TextBandFlush();
+    if( !wBandBits )
+        xBand = x;
+
+    for( wPos = wBandBits; wPos < wBandBits + wWidth; wPos += 8, lpSrc += wHeight ) {
+        lpDst  = (BYTE __far *)(wBandSel :> 0) + (wPos >> 3);
+        wShift = wPos & 7;
+        bKeep  = (BYTE)(0xFF00 >> wShift);
+        for( wRow = 0; wRow < wBandRows; ++wRow, lpDst += wBandPitch ) {
+            b = lpSrc[wRow];
+            lpDst[0] = (lpDst[0] & bKeep) | (b >> wShift);
+            lpDst[1] = b << (8 - wShift);
+        }
+    }
+    wBandBits += wWidth;
+}
+
+/* Draw text on the screen. Handles plain raster fonts without any
+ * transform, character spacing, or justification, with an optional
+ * opaque rectangle. Everything else goes to the DIB Engine.
+ */
+DWORD WINAPI __loadds ExtTextOut( LPDIBENGINE lpDestDev, WORD wDestXOrg, WORD wDestYOrg, LPRECT lpClipRect,
+                                  LPSTR lpString, int wCount, LPFONTINFO lpFontInfo, LPDRAWMODE lpDrawMode,
+                                  LPTEXTXFORM lpTextXForm, LPSHORT lpCharWidths, LPRECT lpOpaqueRect,
+                                  WORD wOptions )
+{
+    LPFONT30    lpFont = (LPFONT30)lpFontInfo;
+    WORD        wFlags = lpDestDev->deFlags;
+    WORD        wHeight, wWidth, wGlyph, wGlyphW;
+    WORD        wSel;
+    DWORD       dwBase, dwBits;
+    HGLOBAL     hMem;
+    RECT        rcClip, rcOpaque, rcAccess;
+    int         x = (short)wDestXOrg;
+    int         y = (short)wDestYOrg;
+    int         bOpaqueText;
+    int         yEnd;
+    int         i;
+
+    /* The screen, a plain raster font, no simulations. */
+    if( !(wFlags & VRAM) || (wFlags & BUSY) || lpDestDev->deBitsPixel < 8 || !Kern.pfnMono )
+        goto punt;
+    if( wCount < 0 || !wBigFonts || !lpFont || !lpDrawMode || lpCharWidths )
+        goto punt;
+    if( (lpFont->dfType & (PF_VECTOR_TYPE | PF_OTHER1_TYPE | PF_BITS_IS_ADDRESS | PF_DEVICE_REALIZED | PF_GLYPH_INDEX))
+     || !(lpFont->dfFlags & (DFF_FIXED | DFF_PROPORTIONAL)) || (lpFont->dfFlags & DFF_UNSUPPORTED) )
+        goto punt;
+    if( lpDrawMode->CharExtra || lpDrawMode->TBreakExtra )
+        goto punt;
+    if( lpTextXForm && (lpTextXForm->ftEscapement || lpTextXForm->ftOrientation || lpTextXForm->ftItalic
+     || lpTextXForm->ftUnderline || lpTextXForm->ftStrikeOut || lpTextXForm->ftOverhang
+     || lpTextXForm->ftHeight != lpFont->dfPixHeight) )
+        goto punt;
+    if( lpOpaqueRect && (wOptions & ETO_OPAQUE) && !Kern.pfnFill )
+        goto punt;
+
+    if( !wBandSel ) {
+        hMem = GlobalAlloc( GMEM_FIXED | GMEM_SHARE, TEXT_BAND_SIZE );
+        if( !hMem )
+            goto punt;
+        wBandSel = (__segment)GlobalLock( hMem );
+    }
+
+    /* Measure the string. Each glyph must fit in the band, and its bits
+     * in the font's segment.
+     */
+    wHeight = lpFont->dfPixHeight;
+    wWidth  = 0;
+    dwBase  = (WORD)(DWORD)lpFont;
+    if( !wHeight )
+        goto punt;
+    for( i = 0; i < wCount; ++i ) {
+        wGlyph = (BYTE)lpString[i];
+        if( wGlyph < lpFont->dfFirstChar || wGlyph > lpFont->dfLastChar )
+            wGlyph = lpFont->dfDefaultChar;
+        else
+            wGlyph -= lpFont->dfFirstChar;
+        wGlyphW = lpFont->dfCharTable[wGlyph].geWidth;
+        dwBits  = dwBase + lpFont->dfCharTable[wGlyph].geOffset;
+        if( ((wGlyphW + 7) >> 3) + 1 > TEXT_BAND_SIZE / wHeight || wGlyphW > TEXT_BAND_PITCH * 8 - 16
+         || dwBits + (DWORD)((wGlyphW + 7) >> 3) * wHeight > 0x10000UL )
+            goto punt;
+        wWidth += wGlyphW;
+    }
+
+    /* Work out the clipping. */
+    rcClip.left   = 0;
+    rcClip.top    = 0;
+    rcClip.right  = lpDestDev->deWidth;
+    rcClip.bottom = lpDestDev->deHeight;
+    if( lpClipRect && !TextClip( &rcClip, lpClipRect ) )
+        return( MAKELONG( wWidth, wHeight ) );
+    rcTextClip = rcClip;
+    if( lpOpaqueRect && (wOptions & ETO_CLIPPED) && !TextClip( &rcTextClip, lpOpaqueRect ) )
+        rcTextClip.right = rcTextClip.left;
+
+    rcOpaque.left = rcOpaque.right = 0;
+    if( lpOpaqueRect && (wOptions & ETO_OPAQUE) ) {
+        rcOpaque = *lpOpaqueRect;
+        if( !TextClip( &rcOpaque, &rcClip ) )
+            rcOpaque.left = rcOpaque.right = 0;
+    }
+
+    /* Exclude the cursor once, from everything that will be drawn. */
+    rcAccess.left   = x;
+    rcAccess.top    = y;
+    rcAccess.right  = x + wWidth;
+    rcAccess.bottom = y + wHeight;
+    if( !TextClip( &rcAccess, &rcTextClip ) )
+        rcAccess = rcOpaque;
+    else if( rcOpaque.left < rcOpaque.right ) {
+        if( rcOpaque.left < rcAccess.left )
+            rcAccess.left = rcOpaque.left;
+        if( rcOpaque.top < rcAccess.top )
+            rcAccess.top = rcOpaque.top;
+        if( rcOpaque.right > rcAccess.right )
+            rcAccess.right = rcOpaque.right;
+        if( rcOpaque.bottom > rcAccess.bottom )
+            rcAccess.bottom = rcOpaque.bottom;
+    }
+    if( rcAccess.left >= rcAccess.right || rcAccess.top >= rcAccess.bottom )
+        return( MAKELONG( wWidth, wHeight ) );
+
+    lpTextDev   = lpDestDev;
+    bOpaqueText = lpDrawMode->bkMode != TRANSPARENT;
+    ((BEGINACCESSPROC)lpDestDev->deBeginAccess)( lpDestDev, rcAccess.left, rcAccess.top,
+                                                 rcAccess.right - 1, rcAccess.bottom - 1, CURSOREXCLUDE );
+
+    /* Fill the opaque rectangle. Where opaque text will cover it anyway,
+     * leave it alone; the band of scanlines holding the text is only
+     * filled to the left and right of the string.
+     */
+    if( rcOpaque.left < rcOpaque.right ) {
+        if( bOpaqueText && wCount ) {
+            TextFill( rcOpaque.left, rcOpaque.top, rcOpaque.right, y, &rcOpaque, lpDrawMode->LbkColor );
+            TextFill( rcOpaque.left, y, x, y + wHeight, &rcOpaque, lpDrawMode->LbkColor );
+            TextFill( x + wWidth, y, rcOpaque.right, y + wHeight, &rcOpaque, lpDrawMode->LbkColor );
+            TextFill( rcOpaque.left, y + wHeight, rcOpaque.right, rcOpaque.bottom, &rcOpaque, lpDrawMode->LbkColor );
+        } else {
+            TextFill( rcOpaque.left, rcOpaque.top, rcOpaque.right, rcOpaque.bottom, &rcOpaque, lpDrawMode->LbkColor );
+        }
+    }
+
+    /* Draw the glyphs: the visible rows of the string go through the
+     * band, which is expanded once unless the string overflows it.
+     */
+    MonoSetColors( lpDestDev->deBitsPixel, lpDrawMode->LTextColor, lpDrawMode->LbkColor );
+    wSel  = (__segment)lpFont;
+    yBand = y < rcTextClip.top ? rcTextClip.top : y;
+    yEnd  = y + wHeight < rcTextClip.bottom ? y + wHeight : rcTextClip.bottom;
+    if( yBand < yEnd ) {
+        wBandRows  = yEnd - yBand;
+        wBandPitch = TEXT_BAND_SIZE / wBandRows;
+        if( wBandPitch > TEXT_BAND_PITCH )
+            wBandPitch = TEXT_BAND_PITCH;
+        wBandBits  = 0;
+        bBandTransparent = !bOpaqueText;
+        for( i = 0; i < wCount && x < rcTextClip.right; ++i ) {
+            wGlyph = (BYTE)lpString[i];
+            if( wGlyph < lpFont->dfFirstChar || wGlyph > lpFont->dfLastChar )
+                wGlyph = lpFont->dfDefaultChar;
+            else
+                wGlyph -= lpFont->dfFirstChar;
+            wGlyphW = lpFont->dfCharTable[wGlyph].geWidth;
+            if( x + (int)wGlyphW > rcTextClip.left )
+                TextBandAdd( x, wGlyphW, wHeight, wSel,
+                             (WORD)(dwBase + lpFont->dfCharTable[wGlyph].geOffset) + (yBand - y) );
+            x += wGlyphW;
+        }
+        TextBandFlush();
+    }
+
+    ((ENDACCESSPROC)lpDestDev->deEndAccess)( lpDestDev, CURSOREXCLUDE );
+    return( MAKELONG( wWidth, wHeight ) );
+
+punt:
+    return( DIB_ExtTextOut( lpDestDev, wDestXOrg, wDestYOrg, lpClipRect, lpString, wCount, lpFontInfo,
+                            lpDrawMode, lpTextXForm, lpCharWidths, lpOpaqueRect, wOptions ) );
+}